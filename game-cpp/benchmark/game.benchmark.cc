@@ -0,0 +1,223 @@
+#include "src/game.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "src/replay.h"
+
+namespace uchen::demo {
+namespace {
+
+constexpr int kSize = 64;
+
+// Cells in random order, so the board fills up evenly.
+std::vector<size_t> ScatteredMoves(size_t count, int seed) {
+  std::vector<size_t> moves(kSize * kSize);
+  std::iota(moves.begin(), moves.end(), 0);
+  std::shuffle(moves.begin(), moves.end(), std::mt19937(seed));
+  moves.resize(count);
+  return moves;
+}
+
+// Moves next to the existing dots, same as the autoplayer picks them.
+std::vector<size_t> ClusteredMoves(size_t count, int seed) {
+  std::mt19937 gen(seed);
+  Game game(kSize, kSize);
+  std::vector<size_t> moves = {31 * kSize + 31};
+  game.PlaceDot(moves.front(), 1);
+  while (moves.size() < count) {
+    std::vector<int> candidates = game.GetGoodAutoplayerIndexes();
+    if (candidates.empty()) {
+      break;
+    }
+    // Candidates come shuffled with a random seed.
+    std::sort(candidates.begin(), candidates.end());
+    std::uniform_int_distribution<size_t> dis(0, candidates.size() - 1);
+    moves.push_back(candidates[dis(gen)]);
+    game.PlaceDot(moves.back(), moves.size() % 2 + 1);
+  }
+  return moves;
+}
+
+void PlayMoves(benchmark::State& state, const std::vector<size_t>& moves) {
+  for (auto _ : state) {
+    Game game(kSize, kSize);
+    for (size_t i = 0; i < moves.size(); ++i) {
+      game.PlaceDot(moves[i], i % 2 + 1);
+    }
+    benchmark::DoNotOptimize(game.player_score(1));
+  }
+  state.SetItemsProcessed(state.iterations() * moves.size());
+}
+
+void BM_PlaceDotScattered(benchmark::State& state) {
+  PlayMoves(state, ScatteredMoves(state.range(0), 42));
+}
+
+void BM_PlaceDotClustered(benchmark::State& state) {
+  PlayMoves(state, ClusteredMoves(state.range(0), 42));
+}
+
+// Position after the clustered moves.
+Game ClusteredPosition(size_t dots, int seed) {
+  Game game(kSize, kSize);
+  std::vector<size_t> moves = ClusteredMoves(dots, seed);
+  for (size_t i = 0; i < moves.size(); ++i) {
+    game.PlaceDot(moves[i], i % 2 + 1);
+  }
+  return game;
+}
+
+// Moves of the checked in self-play replay, starting with the dot self-play
+// places before recording.
+std::optional<std::vector<std::pair<size_t, uint8_t>>> ReplayMoves() {
+  std::ifstream is("replays.dots", std::ios::binary);
+  std::optional<DotGameReplay> replay = DotGameReplay::Load(is);
+  if (!replay.has_value() || replay->turns() == 0) {
+    return std::nullopt;
+  }
+  std::vector<std::pair<size_t, uint8_t>> moves = {{31 * kSize + 31, 1}};
+  for (const DotGameReplay::Move& move : replay->Moves()) {
+    moves.emplace_back(move.index, move.player);
+  }
+  return moves;
+}
+
+// Single dot on a board that already has range(0) dots on it. Rolled back
+// after every move, so the board stays the same.
+void BM_PlaceDot(benchmark::State& state) {
+  Game game = ClusteredPosition(state.range(0), 42);
+  std::vector<uint16_t> moves(game.good_moves().begin(),
+                              game.good_moves().end());
+  size_t i = 0;
+  uint8_t player = state.range(0) % 2 + 1;
+  for (auto _ : state) {
+    size_t checkpoint = game.Checkpoint();
+    benchmark::DoNotOptimize(game.PlaceDot(moves[i++ % moves.size()], player));
+    game.Rollback(checkpoint);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Paths between the dots of the first player on a dense board, most of them
+// do not exist.
+void BM_PathBetween(benchmark::State& state) {
+  Game game = ClusteredPosition(state.range(0), 42);
+  std::vector<size_t> dots;
+  for (size_t i = 0; i < game.field().size(); ++i) {
+    if (game.field()[i] == 1) {
+      dots.push_back(i);
+    }
+  }
+  std::shuffle(dots.begin(), dots.end(), std::mt19937(7));
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t start = dots[i++ % dots.size()];
+    size_t end = dots[i++ % dots.size()];
+    benchmark::DoNotOptimize(game.PathBetween(start, end).size());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Closing a square of the first player around a dot of the second one, with
+// range(0) cells from the center to the sides. Covers finding the path,
+// filling it and outlining the new region.
+void BM_Enclose(benchmark::State& state) {
+  int radius = state.range(0);
+  int center = kSize / 2;
+  Game game(kSize, kSize);
+  game.PlaceDot(center * kSize + center, 2);
+  std::vector<size_t> square;
+  for (int d = -radius; d < radius; ++d) {
+    square.push_back((center - radius) * kSize + center + d);
+    square.push_back((center + d) * kSize + center + radius);
+    square.push_back((center + radius) * kSize + center - d);
+    square.push_back((center - d) * kSize + center - radius);
+  }
+  size_t closing = square.back();
+  square.pop_back();
+  for (size_t index : square) {
+    game.PlaceDot(index, 1);
+  }
+  for (auto _ : state) {
+    size_t checkpoint = game.Checkpoint();
+    benchmark::DoNotOptimize(game.PlaceDot(closing, 1));
+    game.Rollback(checkpoint);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+void BM_GetGoodAutoplayerIndexes(benchmark::State& state) {
+  Game game = ClusteredPosition(state.range(0), 42);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(game.GetGoodAutoplayerIndexes());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// Random good moves until there are none left. Moves/s.
+void BM_RandomGame(benchmark::State& state) {
+  std::mt19937 gen(42);
+  size_t moves = 0;
+  for (auto _ : state) {
+    Game game(state.range(0), state.range(0));
+    game.PlaceDot(state.range(0) / 2 * (state.range(0) + 1), 1);
+    uint8_t player = 2;
+    for (std::optional<size_t> move = game.SampleGoodMove(gen);
+         move.has_value(); move = game.SampleGoodMove(gen)) {
+      game.PlaceDot(*move, player);
+      player = 3 - player;
+      ++moves;
+    }
+    benchmark::DoNotOptimize(game.player_score(1));
+  }
+  state.SetItemsProcessed(moves);
+}
+
+void BM_Replay(benchmark::State& state) {
+  std::optional moves = ReplayMoves();
+  if (!moves.has_value()) {
+    state.SkipWithError("Unable to load replays.dots");
+    return;
+  }
+  for (auto _ : state) {
+    Game game(kSize, kSize);
+    for (auto [index, player] : *moves) {
+      game.PlaceDot(index, player);
+    }
+    benchmark::DoNotOptimize(game.player_score(1));
+  }
+  state.SetItemsProcessed(state.iterations() * moves->size());
+}
+
+BENCHMARK(BM_PlaceDotScattered)->Arg(512)->Arg(2048)->Arg(4096);
+BENCHMARK(BM_PlaceDotClustered)->Arg(512)->Arg(2048)->Arg(4096);
+// Sparse, medium and dense boards.
+BENCHMARK(BM_PlaceDot)->Arg(64)->Arg(512)->Arg(2048);
+BENCHMARK(BM_PathBetween)->Arg(2048);
+BENCHMARK(BM_Enclose)->Arg(1)->Arg(4)->Arg(30);
+BENCHMARK(BM_GetGoodAutoplayerIndexes)->Arg(64)->Arg(512)->Arg(2048);
+BENCHMARK(BM_RandomGame)->Arg(16)->Arg(64);
+BENCHMARK(BM_Replay);
+
+}  // namespace
+}  // namespace uchen::demo
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::SetStderrThreshold(absl::LogSeverity::kWarning);
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+}
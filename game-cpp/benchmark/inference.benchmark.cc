@@ -0,0 +1,51 @@
+#include <cstddef>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "src/batch_inference.h"
+#include "src/game.h"
+
+namespace uchen::demo {
+namespace {
+
+const ModelParameters<Game::QModel>& Parameters() {
+  static const auto* parameters = new ModelParameters<Game::QModel>(
+      RandomParameters(&Game::model, -0.05f, 0.05f, 42));
+  return *parameters;
+}
+
+// One model call per position, the way SuggestMove does it.
+void BM_ModelOneByOne(benchmark::State& state) {
+  std::vector<Game::QModel::input_t> inputs(state.range(0));
+  for (auto _ : state) {
+    for (const auto& input : inputs) {
+      benchmark::DoNotOptimize(Game::model(input, Parameters()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+
+void BM_ModelBatch(benchmark::State& state) {
+  std::vector<Game::QModel::input_t> inputs(state.range(0));
+  BatchInference inference(Parameters());
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(inference.Evaluate(inputs));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+
+BENCHMARK(BM_ModelOneByOne)->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK(BM_ModelBatch)->Arg(1)->Arg(8)->Arg(32);
+
+}  // namespace
+}  // namespace uchen::demo
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::SetStderrThreshold(absl::LogSeverity::kWarning);
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+}
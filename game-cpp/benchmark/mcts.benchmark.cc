@@ -0,0 +1,83 @@
+/*
+Search with a cheap evaluator, so this measures the tree and the game
+updates rather than the model. Nodes/s counts every allocated child. Time
+per search against the number of threads, run on a machine with at least as
+many cores.
+*/
+
+#include "src/mcts.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+
+#include <benchmark/benchmark.h>
+
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "src/game.h"
+
+namespace uchen::demo {
+namespace {
+
+constexpr int kSize = 64;
+
+float ScoreEvaluator(const Game& game, uint8_t player,
+                     std::span<const uint16_t> moves,
+                     std::span<float> priors) {
+  for (float& prior : priors) {
+    prior = 1.f / moves.size();
+  }
+  return std::tanh(static_cast<float>(game.player_score(player)) -
+                   game.player_score(3 - player));
+}
+
+// Opening with some dots around the forced first move.
+Game Opening(size_t moves, int seed) {
+  std::mt19937 gen(seed);
+  Game game(kSize, kSize);
+  game.PlaceDot(31 * kSize + 31, 1);
+  for (size_t i = 1; i < moves; ++i) {
+    game.PlaceDot(*game.SampleGoodMove(gen), i % 2 + 1);
+  }
+  return game;
+}
+
+// Time per move for the given number of threads.
+void BM_MctsSearch(benchmark::State& state) {
+  Game game = Opening(40, 42);
+  Mcts mcts(ScoreEvaluator, {.threads = static_cast<size_t>(state.range(0)),
+                             .max_visits = 2000});
+  size_t nodes = 0;
+  size_t visits = 0;
+  for (auto _ : state) {
+    Mcts::Stats stats;
+    benchmark::DoNotOptimize(mcts.Search(game, 1, &stats));
+    nodes += stats.nodes;
+    visits += stats.visits;
+  }
+  state.counters["nodes/s"] =
+      benchmark::Counter(nodes, benchmark::Counter::kIsRate);
+  state.counters["visits/s"] =
+      benchmark::Counter(visits, benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(BM_MctsSearch)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace uchen::demo
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::SetStderrThreshold(absl::LogSeverity::kWarning);
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,56 @@
+/*
+Heuristic playouts from an opening, to completion or to a fixed depth.
+Games/s is the number of rollouts, items are moves.
+*/
+
+#include "src/rollout.h"
+
+#include <cstddef>
+#include <random>
+
+#include <benchmark/benchmark.h>
+
+#include "absl/log/globals.h"
+#include "absl/log/initialize.h"
+#include "src/game.h"
+
+namespace uchen::demo {
+namespace {
+
+constexpr int kSize = 64;
+
+Game Opening(size_t moves, int seed) {
+  std::mt19937 gen(seed);
+  Game game(kSize, kSize);
+  game.PlaceDot(31 * kSize + 31, 1);
+  for (size_t i = 1; i < moves; ++i) {
+    game.PlaceDot(*game.SampleGoodMove(gen), i % 2 + 1);
+  }
+  return game;
+}
+
+// Depth of the rollout, 0 plays to completion.
+void BM_Rollout(benchmark::State& state) {
+  Game game = Opening(40, 42);
+  Rollout rollout({.max_moves = static_cast<size_t>(state.range(0))}, 42);
+  for (auto _ : state) {
+    size_t checkpoint = game.Checkpoint();
+    benchmark::DoNotOptimize(rollout.Play(game, 1));
+    game.Rollback(checkpoint);
+  }
+  state.counters["games/s"] =
+      benchmark::Counter(rollout.stats().games, benchmark::Counter::kIsRate);
+  state.SetItemsProcessed(rollout.stats().moves);
+}
+
+BENCHMARK(BM_Rollout)->Arg(16)->Arg(64)->Arg(0)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace uchen::demo
+
+int main(int argc, char** argv) {
+  absl::InitializeLog();
+  absl::SetStderrThreshold(absl::LogSeverity::kWarning);
+  ::benchmark::Initialize(&argc, argv);
+  ::benchmark::RunSpecifiedBenchmarks();
+}
@@ -0,0 +1,229 @@
+#include "src/alpha_beta.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+
+namespace uchen::demo {
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+// Killers are tried after the table move and before the rest.
+constexpr float kKillerScore = std::numeric_limits<float>::max() / 2;
+constexpr uint16_t kNoKiller = std::numeric_limits<uint16_t>::max();
+
+uint8_t Opponent(uint8_t player) { return 3 - player; }
+
+float Evaluate(const Game& game, uint8_t player) {
+  return static_cast<float>(game.player_score(player)) -
+         static_cast<float>(game.player_score(Opponent(player)));
+}
+
+}  // namespace
+
+AlphaBeta::AlphaBeta(MoveScorer scorer, Options options)
+    : scorer_(std::move(scorer)),
+      options_(options),
+      history_(Game::kBufferSize, 0) {
+  CHECK_GT(options_.max_depth, 0);
+  CHECK_LT(options_.max_depth, kMaxPly);
+  for (size_t ply = 0; ply <= options_.max_depth; ++ply) {
+    scored_[ply].reserve(Game::kBufferSize);
+    moves_[ply].reserve(Game::kBufferSize);
+  }
+}
+
+AlphaBeta::MoveScorer AlphaBeta::QModelScorer(
+    const ModelParameters<Game::QModel>& par) {
+  return [&par](const Game& game, uint8_t player, std::span<float> scores) {
+    auto output = Game::model(game.features(player), par);
+    std::copy(output.data().begin(), output.data().end(), scores.begin());
+  };
+}
+
+std::optional<size_t> AlphaBeta::Search(Game& game, uint8_t player,
+                                        TranspositionTable* table,
+                                        Stats* stats) {
+  start_ = std::chrono::steady_clock::now();
+  nodes_ = 0;
+  aborted_ = false;
+  table_ = table;
+  if (game.good_moves().empty()) {
+    return std::nullopt;
+  }
+  std::fill(history_.begin(), history_.end(), 0);
+  if (scorer_) {
+    // Scores are squashed to [0, 1], the first cutoff outweighs them.
+    scorer_(game, player, history_);
+    auto [min, max] = std::minmax_element(history_.begin(), history_.end());
+    float low = *min;
+    float range = *max - *min;
+    for (float& score : history_) {
+      score = range > 0 ? (score - low) / range : 0;
+    }
+  }
+  for (auto& killers : killers_) {
+    killers.fill(kNoKiller);
+  }
+  std::optional<uint16_t> best;
+  float best_value = 0;
+  size_t completed = 0;
+  for (size_t depth = 1; depth <= options_.max_depth; ++depth) {
+    std::span<const uint16_t> moves = OrderMoves(game, 0, best);
+    float alpha = -kInfinity;
+    std::optional<uint16_t> iteration_best;
+    for (uint16_t move : moves) {
+      size_t checkpoint = game.Checkpoint();
+      game.PlaceDot(move, player);
+      float value = -Negamax(game, Opponent(player), depth - 1, 1, -kInfinity,
+                             -alpha);
+      game.Rollback(checkpoint);
+      if (aborted_) {
+        break;
+      }
+      if (value > alpha) {
+        alpha = value;
+        iteration_best = move;
+      }
+    }
+    if (aborted_) {
+      break;
+    }
+    best = iteration_best;
+    best_value = alpha;
+    completed = depth;
+  }
+  if (!best.has_value()) {
+    // Not even the first iteration finished.
+    best = OrderMoves(game, 0, std::nullopt).front();
+  }
+  if (stats != nullptr) {
+    stats->depth = completed;
+    stats->nodes = nodes_;
+    stats->value = best_value;
+    stats->elapsed = std::chrono::steady_clock::now() - start_;
+  }
+  return *best;
+}
+
+float AlphaBeta::Negamax(Game& game, uint8_t player, size_t depth, size_t ply,
+                         float alpha, float beta) {
+  ++nodes_;
+  if (OutOfTime()) {
+    return 0;
+  }
+  if (depth == 0 || game.good_moves().empty()) {
+    return Evaluate(game, player);
+  }
+  const float original_alpha = alpha;
+  uint64_t key = game.position_key(player);
+  std::optional<uint16_t> table_move;
+  if (table_ != nullptr) {
+    if (std::optional<TranspositionTable::Entry> entry = table_->Probe(key)) {
+      if (game.is_good_move(entry->move)) {
+        table_move = entry->move;
+      }
+      // Depth 0 entries are model evaluations, not search results.
+      if (entry->depth >= depth) {
+        if (entry->bound == TranspositionTable::Bound::kExact) {
+          return entry->value;
+        } else if (entry->bound == TranspositionTable::Bound::kLower) {
+          alpha = std::max(alpha, entry->value);
+        } else {
+          beta = std::min(beta, entry->value);
+        }
+        if (alpha >= beta) {
+          return entry->value;
+        }
+      }
+    }
+  }
+  float best = -kInfinity;
+  uint16_t best_move = 0;
+  for (uint16_t move : OrderMoves(game, ply, table_move)) {
+    size_t checkpoint = game.Checkpoint();
+    game.PlaceDot(move, player);
+    float value =
+        -Negamax(game, Opponent(player), depth - 1, ply + 1, -beta, -alpha);
+    game.Rollback(checkpoint);
+    if (aborted_) {
+      return 0;
+    }
+    if (value > best) {
+      best = value;
+      best_move = move;
+    }
+    alpha = std::max(alpha, value);
+    if (alpha >= beta) {
+      if (killers_[ply][0] != move) {
+        killers_[ply][1] = killers_[ply][0];
+        killers_[ply][0] = move;
+      }
+      history_[move] += depth * depth;
+      break;
+    }
+  }
+  if (table_ != nullptr) {
+    TranspositionTable::Bound bound =
+        best <= original_alpha ? TranspositionTable::Bound::kUpper
+        : best >= beta         ? TranspositionTable::Bound::kLower
+                               : TranspositionTable::Bound::kExact;
+    table_->Store(key, {.move = best_move,
+                        .depth = static_cast<uint8_t>(depth),
+                        .bound = bound,
+                        .value = best});
+  }
+  return best;
+}
+
+std::span<const uint16_t> AlphaBeta::OrderMoves(const Game& game, size_t ply,
+                                                std::optional<uint16_t> first) {
+  std::vector<std::pair<float, uint16_t>>& scored = scored_[ply];
+  scored.clear();
+  for (uint16_t move : game.good_moves()) {
+    float score = history_[move];
+    if (first == move) {
+      score = kInfinity;
+    } else if (killers_[ply][0] == move || killers_[ply][1] == move) {
+      score = kKillerScore;
+    }
+    scored.emplace_back(score, move);
+  }
+  size_t width = options_.max_width == 0
+                     ? scored.size()
+                     : std::min(options_.max_width, scored.size());
+  // Ties go to the lower cell, so the order does not depend on the order of
+  // the good moves.
+  std::partial_sort(scored.begin(), scored.begin() + width, scored.end(),
+                    [](const auto& a, const auto& b) {
+                      return a.first > b.first ||
+                             (a.first == b.first && a.second < b.second);
+                    });
+  std::vector<uint16_t>& moves = moves_[ply];
+  moves.clear();
+  for (size_t i = 0; i < width; ++i) {
+    moves.push_back(scored[i].second);
+  }
+  return moves;
+}
+
+bool AlphaBeta::OutOfTime() {
+  // Reading the clock is slower than a node, check every so often.
+  if (!aborted_ && nodes_ % 256 == 0) {
+    // Budget in nanoseconds would overflow with the default value.
+    aborted_ = std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::steady_clock::now() - start_) >=
+               options_.time_budget;
+  }
+  return aborted_;
+}
+
+}  // namespace uchen::demo
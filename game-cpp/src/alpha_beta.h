@@ -0,0 +1,94 @@
+#ifndef SRC_ALPHA_BETA_H
+#define SRC_ALPHA_BETA_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "src/game.h"
+#include "src/transposition_table.h"
+
+namespace uchen::demo {
+
+// Iterative deepening negamax with alpha-beta pruning. Positions are scored
+// by the difference in captured dots. Moves are made on the searched game and
+// rolled back through checkpoints, the game is never copied. Moves are tried
+// in this order: the best move from the table or from the previous iteration,
+// the killer moves of the ply, then by history. History starts from the move
+// scores of the root position, so the model can steer the first iteration.
+class AlphaBeta {
+ public:
+  // Fills a score for every cell, moves with higher scores are tried first.
+  using MoveScorer = std::function<void(const Game& game, uint8_t player,
+                                        std::span<float> scores)>;
+
+  struct Options {
+    size_t max_depth = 4;
+    // Search returns the move of the last completed iteration when the
+    // budget runs out.
+    std::chrono::milliseconds time_budget = std::chrono::milliseconds::max();
+    // Moves tried in every node, the best ordered first. 0 tries all the good
+    // moves.
+    size_t max_width = 0;
+  };
+
+  struct Stats {
+    // Depth of the last completed iteration.
+    size_t depth = 0;
+    size_t nodes = 0;
+    // Value of the best move for the player, in captured dots.
+    float value = 0;
+    std::chrono::nanoseconds elapsed{0};
+
+    double nodes_per_second() const {
+      return elapsed.count() == 0 ? 0 : nodes * 1e9 / elapsed.count();
+    }
+  };
+
+  // Scorer is optional, without it history starts empty.
+  AlphaBeta(MoveScorer scorer, Options options);
+
+  // Q-values of the model. Parameters must outlive the scorer.
+  static MoveScorer QModelScorer(const ModelParameters<Game::QModel>& par);
+
+  // Returns the best move or nullopt if the player has no moves. The game is
+  // back to the original position when this returns. Table is optional and
+  // may be shared with other searches.
+  std::optional<size_t> Search(Game& game, uint8_t player,
+                               TranspositionTable* table = nullptr,
+                               Stats* stats = nullptr);
+
+ private:
+  static constexpr size_t kMaxPly = 64;
+
+  // Value for the player to move.
+  float Negamax(Game& game, uint8_t player, size_t depth, size_t ply,
+                float alpha, float beta);
+  // Fills the moves of the ply, best first.
+  std::span<const uint16_t> OrderMoves(const Game& game, size_t ply,
+                                       std::optional<uint16_t> first);
+  bool OutOfTime();
+
+  MoveScorer scorer_;
+  Options options_;
+  // Per cell, bumped when a move causes a cutoff.
+  std::vector<float> history_;
+  std::array<std::array<uint16_t, 2>, kMaxPly> killers_;
+  // Scratch space of every ply, allocated once.
+  std::array<std::vector<std::pair<float, uint16_t>>, kMaxPly> scored_;
+  std::array<std::vector<uint16_t>, kMaxPly> moves_;
+  TranspositionTable* table_ = nullptr;
+  std::chrono::steady_clock::time_point start_;
+  size_t nodes_ = 0;
+  bool aborted_ = false;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_ALPHA_BETA_H
@@ -0,0 +1,89 @@
+#include "src/batch_inference.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "src/convolution.h"
+
+namespace uchen::demo {
+namespace {
+
+using QModel = Game::QModel;
+
+template <size_t I>
+using LayerOutput = typename QModel::template Traits<I>::output_t;
+
+static_assert(
+    std::is_same_v<QModel::L<4>, uchen::Linear<LayerOutput<3>, 128>>);
+static_assert(
+    std::is_same_v<QModel::L<6>, uchen::Linear<LayerOutput<5>, 64 * 64>>);
+
+// Same as uchen::Linear for every input: bias comes first, followed by the
+// column-major weights. Each column is read once for the whole batch.
+template <size_t Inputs, size_t Outputs>
+void LinearBatch(std::span<const float> inputs, std::span<float> outputs,
+                 const Parameters<(Inputs + 1) * Outputs>& parameters,
+                 size_t batch) {
+  const float* bias = parameters.data();
+  const float* weights = parameters.data() + Outputs;
+  for (size_t item = 0; item < batch; ++item) {
+    std::copy(bias, bias + Outputs, outputs.begin() + item * Outputs);
+  }
+  for (size_t i = 0; i < Inputs; ++i) {
+    const float* column = weights + i * Outputs;
+    for (size_t item = 0; item < batch; ++item) {
+      float x = inputs[item * Inputs + i];
+      // Most of the inputs were zeroed by ReLU.
+      if (x == 0) {
+        continue;
+      }
+      float* y = outputs.data() + item * Outputs;
+      for (size_t o = 0; o < Outputs; ++o) {
+        y[o] += column[o] * x;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+BatchInference::BatchInference(ModelParameters<Game::QModel> parameters)
+    : parameters_(std::move(parameters)) {}
+
+std::span<const float> BatchInference::Evaluate(
+    std::span<const Game::QModel::input_t> inputs) {
+  constexpr size_t kInputElements = QModel::input_t::elements;
+  size_t batch = inputs.size();
+  if (batch == 0) {
+    return {};
+  }
+  input_.resize(batch * kInputElements);
+  for (size_t item = 0; item < batch; ++item) {
+    std::copy(inputs[item].data().begin(), inputs[item].data().end(),
+              input_.begin() + item * kInputElements);
+  }
+  conv1_.resize(batch * LayerOutput<1>::elements);
+  conv2_.resize(batch * LayerOutput<2>::elements);
+  conv3_.resize(batch * LayerOutput<3>::elements);
+  hidden_.resize(batch * LayerOutput<4>::elements);
+  output_.resize(batch * kOutputs);
+  Game::model.layer<1>().Batch(input_, conv1_,
+                               parameters_.layer_parameters<1>(), batch);
+  Game::model.layer<2>().Batch(conv1_, conv2_,
+                               parameters_.layer_parameters<2>(), batch);
+  Game::model.layer<3>().Batch(conv2_, conv3_,
+                               parameters_.layer_parameters<3>(), batch);
+  LinearBatch<LayerOutput<3>::elements, LayerOutput<4>::elements>(
+      conv3_, hidden_, parameters_.layer_parameters<4>(), batch);
+  for (float& h : hidden_) {
+    h = std::max(h, 0.f);
+  }
+  LinearBatch<LayerOutput<5>::elements, kOutputs>(
+      hidden_, output_, parameters_.layer_parameters<6>(), batch);
+  return output_;
+}
+
+}  // namespace uchen::demo
@@ -0,0 +1,45 @@
+#ifndef SRC_BATCH_INFERENCE_H
+#define SRC_BATCH_INFERENCE_H
+
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "src/game.h"
+
+namespace uchen::demo {
+
+// Runs the Q-model on many positions at once. Every layer goes through the
+// whole batch before the next one starts, so the weights are read from memory
+// once per batch rather than once per position. Buffers are reused between
+// calls, an instance should not be shared between threads.
+class BatchInference {
+ public:
+  static constexpr size_t kOutputs = Game::QModel::output_t::elements;
+
+  explicit BatchInference(ModelParameters<Game::QModel> parameters);
+
+  // Buffers are kept, only the weights change.
+  void set_parameters(ModelParameters<Game::QModel> parameters) {
+    parameters_ = std::move(parameters);
+  }
+
+  // Returns kOutputs Q-values per input, in the order of the inputs. Result is
+  // valid until the next call.
+  std::span<const float> Evaluate(
+      std::span<const Game::QModel::input_t> inputs);
+
+ private:
+  ModelParameters<Game::QModel> parameters_;
+  std::vector<float> input_;
+  std::vector<float> conv1_;
+  std::vector<float> conv2_;
+  std::vector<float> conv3_;
+  std::vector<float> hidden_;
+  std::vector<float> output_;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_BATCH_INFERENCE_H
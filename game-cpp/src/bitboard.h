@@ -0,0 +1,149 @@
+#ifndef SRC_BITBOARD_H
+#define SRC_BITBOARD_H
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace uchen::demo {
+
+// One bit per cell of the field, one 64-bit word per row. Fields up to 64x64
+// are supported, cell at (x, y) is bit x of row y.
+class Bitboard {
+ public:
+  static constexpr size_t kRows = 64;
+  static constexpr size_t kColumns = 64;
+
+  constexpr Bitboard() = default;
+
+  // Cells x in [left, right] of the rows [top, bottom].
+  static constexpr Bitboard Rectangle(size_t left, size_t top, size_t right,
+                                      size_t bottom) {
+    Bitboard result;
+    uint64_t row = (~uint64_t{0} >> (kColumns - 1 - right)) &
+                   (~uint64_t{0} << left);
+    for (size_t y = top; y <= bottom; ++y) {
+      result.rows_[y] = row;
+    }
+    return result;
+  }
+
+  // Cells of the open set in the rows [top, bottom] reachable from the seeds
+  // through the orthogonal neighbors. Every row is filled along its open spans
+  // in one go, then the rows are swept down and up until nothing changes,
+  // which takes a single round for the convex areas.
+  static Bitboard Flood(const Bitboard& seeds, const Bitboard& open,
+                        size_t top, size_t bottom) {
+    Bitboard result;
+    for (size_t y = top; y <= bottom; ++y) {
+      result.rows_[y] = FillSpans(seeds.rows_[y], open.rows_[y]);
+    }
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (size_t y = top + 1; y <= bottom; ++y) {
+        changed |= Spread(result, open, y, y - 1);
+      }
+      for (size_t y = bottom; y-- > top;) {
+        changed |= Spread(result, open, y, y + 1);
+      }
+    }
+    return result;
+  }
+
+  // Open spans of the row that have any of the seeds in them. Kogge-Stone
+  // fill in both directions, six steps each.
+  static constexpr uint64_t FillSpans(uint64_t seeds, uint64_t open) {
+    uint64_t left = seeds & open;
+    uint64_t right = left;
+    uint64_t left_open = open;
+    uint64_t right_open = open;
+    for (int shift = 1; shift < 64; shift <<= 1) {
+      left |= left_open & (left << shift);
+      left_open &= left_open << shift;
+      right |= right_open & (right >> shift);
+      right_open &= right_open >> shift;
+    }
+    return left | right;
+  }
+
+  bool test(size_t x, size_t y) const { return (rows_[y] >> x) & 1; }
+  void set(size_t x, size_t y) { rows_[y] |= uint64_t{1} << x; }
+  void reset(size_t x, size_t y) { rows_[y] &= ~(uint64_t{1} << x); }
+
+  uint64_t row(size_t y) const { return rows_[y]; }
+  uint64_t& row(size_t y) { return rows_[y]; }
+
+  size_t count() const {
+    size_t result = 0;
+    for (uint64_t row : rows_) {
+      result += std::popcount(row);
+    }
+    return result;
+  }
+
+  bool empty() const {
+    for (uint64_t row : rows_) {
+      if (row != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Calls fn(x, y) for every set cell, row by row.
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+    for (size_t y = 0; y < kRows; ++y) {
+      for (uint64_t row = rows_[y]; row != 0; row &= row - 1) {
+        fn(static_cast<size_t>(std::countr_zero(row)), y);
+      }
+    }
+  }
+
+  Bitboard& operator|=(const Bitboard& other) {
+    for (size_t y = 0; y < kRows; ++y) {
+      rows_[y] |= other.rows_[y];
+    }
+    return *this;
+  }
+
+  Bitboard& operator&=(const Bitboard& other) {
+    for (size_t y = 0; y < kRows; ++y) {
+      rows_[y] &= other.rows_[y];
+    }
+    return *this;
+  }
+
+  // Clears the cells that are set in the other board.
+  Bitboard& operator-=(const Bitboard& other) {
+    for (size_t y = 0; y < kRows; ++y) {
+      rows_[y] &= ~other.rows_[y];
+    }
+    return *this;
+  }
+
+  friend Bitboard operator|(Bitboard a, const Bitboard& b) { return a |= b; }
+  friend Bitboard operator&(Bitboard a, const Bitboard& b) { return a &= b; }
+  friend Bitboard operator-(Bitboard a, const Bitboard& b) { return a -= b; }
+
+  friend bool operator==(const Bitboard& a, const Bitboard& b) = default;
+
+ private:
+  // Fills the row from the neighbor row. Returns true if it grew.
+  static bool Spread(Bitboard& board, const Bitboard& open, size_t y,
+                     size_t from) {
+    uint64_t seeds = board.rows_[from] & open.rows_[y] & ~board.rows_[y];
+    if (seeds == 0) {
+      return false;
+    }
+    board.rows_[y] |= FillSpans(seeds, open.rows_[y]);
+    return true;
+  }
+
+  std::array<uint64_t, kRows> rows_ = {};
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_BITBOARD_H
@@ -397,7 +397,7 @@ template <size_t Channels>
 HWY_ATTR void Conv2dHighway(std::span<const float> input,
                             std::span<float> output,
                             std::span<const float> weights, size_t columns,
-                            const ConvolutionOptions& options) {
+                            size_t batch, const ConvolutionOptions& options) {
   // 4 channels - fixed tag. Will see if can use scalable for more channels.
   using D = hn::FixedTag<float, 4>;
   D d;
@@ -410,17 +410,25 @@ HWY_ATTR void Conv2dHighway(std::span<const float> input,
       read_offsets.push_back((col + row * columns) * options.input_channels);
     }
   }
-  size_t rows = input.size() / columns / options.input_channels;
-  DataLoader<D, Channels> loader(d, input, read_offsets, columns,
-                                 options.input_channels);
+  const size_t input_elements = input.size() / batch;
+  const size_t output_elements = output.size() / batch;
+  size_t rows = input_elements / columns / options.input_channels;
+  absl::InlinedVector<DataLoader<D, Channels>, 16> loaders;
+  for (size_t item = 0; item < batch; ++item) {
+    loaders.emplace_back(
+        d, input.subspan(item * input_elements, input_elements),
+        read_offsets, columns, options.input_channels);
+  }
   for (size_t kernel = 0; kernel < options.output_channels; ++kernel) {
-    Kernel k(
-        d,
+    std::span<const float> kernel_weights =
         weights.subspan(kernel * read_offsets.size() * options.input_channels,
-                        read_offsets.size() * options.input_channels),
-        kernel, loader, options);
-    k(output.data(), rows - options.kernel_height + 1,
-      columns - options.kernel_width + 1);
+                        read_offsets.size() * options.input_channels);
+    // Kernel weights stay in cache while going through the batch.
+    for (size_t item = 0; item < batch; ++item) {
+      Kernel k(d, kernel_weights, kernel, loaders[item], options);
+      k(output.data() + item * output_elements,
+        rows - options.kernel_height + 1, columns - options.kernel_width + 1);
+    }
   }
 }
 
@@ -504,25 +512,34 @@ HWY_AFTER_NAMESPACE();
 void Conv2d(std::span<const float> input, std::span<float> output,
             std::span<const float> weights, int columns,
             const ConvolutionOptions& options) {
+  Conv2dBatch(input, output, weights, columns, 1, options);
+}
+
+void Conv2dBatch(std::span<const float> input, std::span<float> output,
+                 std::span<const float> weights, int columns, size_t batch,
+                 const ConvolutionOptions& options) {
+  CHECK_GT(batch, 0);
+  CHECK_EQ(input.size() % batch, 0);
+  CHECK_EQ(output.size() % batch, 0);
   std::fill(output.begin(), output.end(), 0);
 
-  int rows = input.size() / options.input_channels / columns;
+  int rows = input.size() / batch / options.input_channels / columns;
   ConvolutionDimensions out_dims = OutputDims(
       {.channels = options.input_channels, .height = rows, .width = columns},
       options);
 
-  CHECK_GE(output.size(),
+  CHECK_GE(output.size() / batch,
            options.output_channels * out_dims.height * out_dims.width);
   CHECK_EQ(options.input_channels % 4,
            0);  // Can't do SIMD otherwise. Just pad the input with zeroes
   // Here we have an opportunity to do some special cases.
   if (options.input_channels == 4) {
     HWY_STATIC_DISPATCH(Conv2dHighway<4>)(input, output, weights, columns,
-                                          options);
+                                          batch, options);
   } else {
     // Will use dynamic channels count.
     HWY_STATIC_DISPATCH(Conv2dHighway<0>)(input, output, weights, columns,
-                                          options);
+                                          batch, options);
   }
 }
 
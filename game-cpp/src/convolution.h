@@ -28,6 +28,12 @@ void Conv2d(std::span<const float> input, std::span<float> output,
             std::span<const float> weights, int columns,
             const ConvolutionOptions& options);
 
+// Same as Conv2d for batch inputs stored one after another. Each kernel is
+// applied to all the inputs before moving to the next one.
+void Conv2dBatch(std::span<const float> input, std::span<float> output,
+                 std::span<const float> weights, int columns, size_t batch,
+                 const ConvolutionOptions& options);
+
 void Conv2dParameterGradients(std::span<const float> output_gradients,
                               std::span<const float> input,
                               std::span<float> out_parameter_gradient,
@@ -137,6 +143,19 @@ class Conv2dLayer {
     return filter_(result);
   }
 
+  // Runs the layer on batch inputs stored one after another. Outputs are
+  // written one after another as well, result_t::elements each.
+  void Batch(std::span<const float> inputs, std::span<float> outputs,
+             const auto& parameters, size_t batch) const {
+    implementation::Conv2dBatch(inputs, outputs, parameters, Input::width,
+                                batch, kOptions);
+    for (size_t i = 0; i < batch; ++i) {
+      std::span<float, result_t::elements> output(
+          outputs.data() + i * result_t::elements, result_t::elements);
+      filter_(result_t{output, nullptr});
+    }
+  }
+
   friend Vector<float, input_t::elements> ComputeGradients(
       const Conv2dLayer& layer, const input_t& input,
       const Vector<float, filtered_result_t::elements>& output_gradients,
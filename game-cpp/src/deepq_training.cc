@@ -1,14 +1,19 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <iterator>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <random>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -17,17 +22,25 @@
 #include "absl/log/globals.h"
 #include "absl/log/initialize.h"
 
+#include "src/batch_inference.h"
 #include "src/deepq_loss.h"
 #include "src/game.h"
+#include "src/game_batch.h"
+#include "src/mcts.h"
+#include "src/mpmc_queue.h"
 #include "src/replay.h"
+#include "src/replay_buffer.h"
+#include "src/transposition_table.h"
+#include "uchen/training/checkpoint.h"
 #include "uchen/training/kaiming_he.h"
+#include "uchen/training/optimizer.h"
 #include "uchen/training/training.h"
 
 using uchen::demo::Game;
 using training_set = std::vector<
     std::pair<Game::QModel::input_t, uchen::learning::DeepQExpectation>>;
 using uchen::ModelParameters;
-using uchen::training::ParameterGradients;
+using Checkpoint = uchen::training::Checkpoint<Game::QModel>;
 
 ABSL_FLAG(uint32_t, steps, 50, "Steps to play");
 ABSL_FLAG(int, seed, 0, "Random seed");
@@ -35,63 +48,35 @@ ABSL_FLAG(bool, force, false, "Overwrite outputs");
 ABSL_FLAG(std::string, input_params, "", "Input parameters");
 ABSL_FLAG(std::string, output_params, "", "Output parameters");
 ABSL_FLAG(float, model_play, 1.f, "How often the model plays");
-
-template <typename M>
-class AdamOptimizer {
- public:
-  AdamOptimizer(float beta1 = 0.9f, float beta2 = 0.999f, float eps = 1e-8f,
-                ParameterGradients<M> m = {}, ParameterGradients<M> v = {},
-                size_t step = 1)
-      : beta1_(beta1),
-        beta2_(beta2),
-        eps_(eps),
-        m_(std::move(m)),
-        v_(std::move(v)),
-        step_(step) {}
-
-  std::pair<ModelParameters<M>, AdamOptimizer<M>> operator()(
-      const ModelParameters<M>& params, const ParameterGradients<M>& grads,
-      size_t batch_size, float learning_rate) const {
-    CHECK_GE(step_, 1);
-    ParameterGradients<M> m;
-    ParameterGradients<M> v;
-    ParameterGradients<M> deltas;  // update buffer
-
-    const float lr_scaled = learning_rate;
-    const float bias_correction1 =
-        1.0f - std::pow(beta1_, static_cast<float>(step_));
-    const float bias_correction2 =
-        1.0f - std::pow(beta2_, static_cast<float>(step_));
-
-    for (size_t i = 0; i < grads.size(); ++i) {
-      float g = grads[i];
-
-      // update biased moments
-      m[i] = beta1_ * m_[i] + (1.0f - beta1_) * g;
-      v[i] = beta2_ * v_[i] + (1.0f - beta2_) * (g * g);
-
-      // bias correction
-      float m_hat = m[i] / bias_correction1;
-      float v_hat = v[i] / bias_correction2;
-
-      // parameter delta
-      deltas[i] = lr_scaled * m_hat / (std::sqrt(v_hat) + eps_);
-    }
-    // update params
-    return {params - deltas, AdamOptimizer{beta1_, beta2_, eps_, std::move(m),
-                                           std::move(v), step_ + 1}};
-  }
-
- private:
-  float beta1_, beta2_, eps_;
-  ParameterGradients<M> m_;
-  ParameterGradients<M> v_;
-  size_t step_;
-};
+ABSL_FLAG(uint32_t, transposition_table_bits, 20,
+          "Log2 of the number of positions cached during self-play, the "
+          "cache is shared by all the games played with the same parameters");
+ABSL_FLAG(uint32_t, mcts_visits, 0,
+          "Simulations per model move, 0 picks the best Q-value instead");
+ABSL_FLAG(uint32_t, mcts_threads, 1, "Threads searching each model move");
+ABSL_FLAG(uint32_t, games, 1,
+          "Games each self-play worker plays in lockstep, the model evaluates "
+          "their positions in one batch");
+ABSL_FLAG(uint32_t, workers, 1,
+          "Self-play threads. With more than one worker or game, worker i "
+          "streams its replays to <file>-<i>");
+ABSL_FLAG(uint32_t, rounds, 1, "Batches of games every self-play worker plays");
+ABSL_FLAG(uint32_t, window, 100000,
+          "Latest self-play transitions the loop verb samples its batches "
+          "from");
+ABSL_FLAG(uint32_t, generations, 100, "Generations the loop verb trains for");
+ABSL_FLAG(uint32_t, replay_buffer, 0,
+          "Transitions the train verb keeps in a prioritized replay buffer, 0 "
+          "trains on all of them every generation");
+ABSL_FLAG(uint32_t, batch_size, 1024,
+          "Samples per optimizer step. Transitions sampled from the replay "
+          "buffer or the loop window every generation, or the mini-batch size "
+          "of the epochs without a buffer");
 
 uchen::demo::DotGameReplay SelfPlay(uint32_t steps,
                                     const ModelParameters<Game::QModel>& par,
-                                    int seed, float use_model) {
+                                    int seed, float use_model,
+                                    uchen::demo::TranspositionTable& table) {
   uchen::demo::DotGameReplay replay;
   std::random_device rd;
   std::mt19937 gen(rd());
@@ -99,6 +84,13 @@ uchen::demo::DotGameReplay SelfPlay(uint32_t steps,
     gen.seed(seed);
   }
 
+  std::optional<uchen::demo::Mcts> mcts;
+  if (absl::GetFlag(FLAGS_mcts_visits) > 0) {
+    mcts.emplace(uchen::demo::Mcts::QModelEvaluator(par),
+                 uchen::demo::Mcts::Options{
+                     .threads = absl::GetFlag(FLAGS_mcts_threads),
+                     .max_visits = absl::GetFlag(FLAGS_mcts_visits)});
+  }
   Game dots_game(64, 64);
   // Always the first turn
   dots_game.PlaceDot(31 * 64 + 31, 1);
@@ -110,12 +102,23 @@ uchen::demo::DotGameReplay SelfPlay(uint32_t steps,
 
   for (size_t step = 0; step < steps; ++step) {
     size_t ind;
-    if (is_model(gen) < use_model) {
-      ind = dots_game.SuggestMove(par);
+    bool model_move = is_model(gen) < use_model;
+    if (model_move && mcts.has_value()) {
+      uchen::demo::Mcts::Stats stats;
+      std::optional<size_t> move = mcts->Search(dots_game, player, &stats);
+      CHECK(move.has_value()) << "No moves left";
+      ind = *move;
+      LOG(INFO) << absl::Substitute("Searched $0 nodes in $1ms, $2 nodes/s",
+                                    stats.nodes, stats.elapsed.count() / 1e6,
+                                    stats.nodes_per_second());
+    } else if (model_move) {
+      std::optional<size_t> move = dots_game.SuggestMove(player, par, &table);
+      CHECK(move.has_value()) << "No moves left";
+      ind = *move;
     } else {
-      std::vector<int> good_indexes = dots_game.GetGoodAutoplayerIndexes();
-      std::uniform_int_distribution<> dis(0, good_indexes.size() - 1);
-      ind = good_indexes[dis(gen)];
+      std::optional<size_t> move = dots_game.SampleGoodMove(gen);
+      CHECK(move.has_value()) << "No moves left";
+      ind = *move;
     }
     dots_game.PlaceDot(ind, player);
     LOG(INFO) << "Step " << step << " Random index from good_indexes: " << ind
@@ -150,16 +153,21 @@ uchen::demo::DotGameReplay SelfPlay(uint32_t steps,
   return replay;
 }
 
-std::optional<std::ofstream> OpenFileForWrite(std::string_view filename,
-                                              bool force) {
-  namespace fs = std::filesystem;
+bool CanCreateFile(std::string_view filename) {
   if (filename.empty()) {
     std::cerr << "Output file name is required.\n";
-    return std::nullopt;
+    return false;
   }
-  fs::path out_path(filename);
-  if (fs::exists(out_path) && !absl::GetFlag(FLAGS_force)) {
+  if (std::filesystem::exists(filename) && !absl::GetFlag(FLAGS_force)) {
     std::cerr << "File already exists: " << filename << "\n";
+    return false;
+  }
+  return true;
+}
+
+std::optional<std::ofstream> OpenFileForWrite(std::string_view filename,
+                                              bool force) {
+  if (!CanCreateFile(filename)) {
     return std::nullopt;
   }
   std::error_code ec;
@@ -190,53 +198,125 @@ std::optional<std::ifstream> OpenFileForRead(std::string_view filename) {
   return ifs;
 }
 
-template <size_t Parameters>
-bool WriteLayerParameters(const uchen::Parameters<Parameters>& p,
-                          std::ostream& stream, size_t* out_wrote) {
-  if constexpr (Parameters == 0) {
-    return true;
-  } else {
-    std::span<const float> span = p;
-    stream.write(reinterpret_cast<const char*>(span.data()),
-                 span.size() * sizeof(float));
-    if (!stream) {
-      return false;
+// Plays the games one step at a time, the model moves of all of them come from
+// one batched evaluation. Positions found in the table are not evaluated. No
+// MCTS.
+std::vector<uchen::demo::DotGameReplay> BatchSelfPlay(
+    uint32_t steps, uchen::demo::BatchInference& inference, uint64_t seed,
+    float use_model, size_t games, uchen::demo::TranspositionTable& table) {
+  uchen::demo::GameBatch batch(games, 64, 64, seed, &table);
+  std::vector<uchen::demo::DotGameReplay> replays(games);
+  for (size_t step = 0; step < steps && batch.active() > 0; ++step) {
+    std::span<const float> q_values;
+    if (use_model > 0) {
+      q_values = inference.Evaluate(batch.Inputs());
+    }
+    std::span<const uint32_t> moves = batch.Step(q_values, use_model);
+    for (size_t i = 0; i < games; ++i) {
+      if (moves[i] != uchen::demo::GameBatch::kNoMove) {
+        // Player to move has changed already.
+        replays[i].RecordTurn(batch.game(i), step, moves[i],
+                              3 - batch.player(i));
+      }
     }
-    *out_wrote += span.size() * sizeof(float);
-    return true;
   }
+  return replays;
 }
 
-template <typename Model, size_t... S>
-std::optional<size_t> WriteParameters(
-    const uchen::ModelParameters<Model>& parameters, std::ostream& stream,
-    std::index_sequence<S...> /* seq */) {
-  size_t wrote = 0;
-  if (true &&
-      (... && WriteLayerParameters(parameters.template layer_parameters<S>(),
-                                   stream, &wrote))) {
-    return wrote;
-  } else {
-    return std::nullopt;
+// Every worker has its own copy of the model and plays rounds of batched
+// games, writing the replays to <path>-<worker> as soon as a round is done.
+// Game g is seeded with seed + g, whichever worker plays it. Workers share one
+// transposition table, so openings evaluated in one game are reused in all.
+bool ParallelSelfPlay(std::string_view path, uint32_t steps,
+                      const ModelParameters<Game::QModel>& par, uint64_t seed,
+                      float use_model, size_t games, size_t workers,
+                      size_t rounds) {
+  std::vector<std::ofstream> shards;
+  for (size_t i = 0; i < workers; ++i) {
+    std::optional ofs = OpenFileForWrite(absl::StrCat(path, "-", i),
+                                         absl::GetFlag(FLAGS_force));
+    if (!ofs.has_value()) {
+      return false;
+    }
+    shards.push_back(std::move(ofs).value());
+  }
+  LOG(INFO) << absl::Substitute(
+      "Self-playing $0 games on $1 workers for $2 steps",
+      games * workers * rounds, workers, steps);
+  uchen::demo::TranspositionTable table(
+      absl::GetFlag(FLAGS_transposition_table_bits));
+  std::atomic<size_t> positions = 0;
+  std::atomic<bool> failed = false;
+  auto start = std::chrono::steady_clock::now();
+  auto worker = [&](size_t index) {
+    uchen::demo::BatchInference inference(par);
+    for (size_t round = 0; round < rounds && !failed; ++round) {
+      uint64_t first_game = (round * workers + index) * games;
+      for (const auto& replay :
+           BatchSelfPlay(steps, inference, seed + first_game, use_model,
+                         games, table)) {
+        positions.fetch_add(replay.turns(), std::memory_order_relaxed);
+        if (!replay.Write(shards[index])) {
+          failed = true;
+        }
+      }
+      shards[index].flush();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back(worker, i);
+  }
+  worker(0);
+  for (std::thread& thread : threads) {
+    thread.join();
   }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  LOG(INFO) << absl::Substitute("Done, $0 positions in $1s, $2 positions/s",
+                                positions.load(), elapsed.count(),
+                                positions.load() / elapsed.count());
+  return !failed;
 }
 
-template <typename Model>
-std::optional<ModelParameters<Model>> ReadParameters(const Model* model,
-                                                     std::ifstream& stream) {
-  // allocate flat store
-  auto store = uchen::NewFlatStore(model, 0.0f);
-  std::span<float> data = store->data();
-
-  // read all parameters at once
-  stream.read(reinterpret_cast<char*>(data.data()),
-              data.size() * sizeof(float));
-  if (!stream) {
+// Parameters are mapped from the file rather than read into memory.
+std::optional<Checkpoint> LoadParameters(const std::string& path) {
+  if (path.empty()) {
+    std::cerr << "Input parameters are required.\n";
     return std::nullopt;
   }
+  std::optional checkpoint =
+      uchen::training::LoadCheckpoint(&Game::model, path);
+  if (!checkpoint.has_value()) {
+    LOG(ERROR) << "Unable to read parameters from " << path;
+  }
+  return checkpoint;
+}
 
-  // wrap in ModelParameters
-  return ModelParameters<Model>(model, std::move(store));
+// Written next to the output and renamed over it, so the file always holds
+// the latest whole checkpoint.
+bool SaveCheckpoint(const std::string& path,
+                    const ModelParameters<Game::QModel>& parameters,
+                    uint64_t generation,
+                    const uchen::training::OptimizerState<Game::QModel>*
+                        optimizer = nullptr) {
+  std::string temp = path + ".tmp";
+  std::ofstream out(temp, std::ios::binary);
+  if (!out ||
+      !uchen::training::WriteCheckpoint(out, parameters, generation,
+                                        optimizer) ||
+      !out.flush()) {
+    LOG(ERROR) << "Can not write " << temp;
+    return false;
+  }
+  out.close();
+  std::error_code ec;
+  std::filesystem::rename(temp, path, ec);
+  if (ec) {
+    LOG(ERROR) << "Can not replace " << path << ": " << ec.message();
+    return false;
+  }
+  return true;
 }
 
 std::optional<std::vector<uchen::demo::DotGameReplay>> ReadReplays(
@@ -248,11 +328,12 @@ std::optional<std::vector<uchen::demo::DotGameReplay>> ReadReplays(
       LOG(FATAL) << "Can not open " << path;
       return std::nullopt;
     }
-    auto replay = uchen::demo::DotGameReplay::Load(*is);
-    if (!replay.has_value()) {
+    // Self-play shards hold many replays one after another.
+    auto shard = uchen::demo::DotGameReplay::LoadAll(*is);
+    if (!shard.has_value()) {
       return std::nullopt;
     }
-    replays.emplace_back(std::move(replay).value());
+    std::move(shard->begin(), shard->end(), std::back_inserter(replays));
   }
   return replays;
 }
@@ -260,23 +341,40 @@ std::optional<std::vector<uchen::demo::DotGameReplay>> ReadReplays(
 using ModelTraining =
     uchen::training::TrainingData<Game::QModel::input_t,
                                   uchen::learning::DeepQExpectation>;
+using QTraining =
+    uchen::training::Training<Game::QModel,
+                              uchen::training::Adam<Game::QModel>,
+                              uchen::learning::DeepQLoss>;
+
+// Continues with the optimizer state of the checkpoint if it has one.
+QTraining ResumeTraining(const Checkpoint& checkpoint) {
+  uchen::training::Adam<Game::QModel> adam;
+  checkpoint.RestoreOptimizer(adam.state());
+  return QTraining(&Game::model, checkpoint.parameters,
+                   uchen::learning::DeepQLoss{}, adam);
+}
 
+void Save(const std::string& path, const QTraining& training,
+          uint64_t generation) {
+  CHECK(SaveCheckpoint(path, training.parameters(), generation,
+                       &training.optimizer().state()));
+}
+
+// Every generation is an epoch of mini-batches over the training data.
 uchen::ModelParameters<Game::QModel> TrainingLoop(
-    const uchen::ModelParameters<Game::QModel>& params,
-    const ModelTraining& training_data, const ModelTraining& verification,
-    std::ostream& oss) {
-  uchen::training::Training training(&Game::model, params,
-                                     uchen::learning::DeepQLoss{},
-                                     AdamOptimizer<Game::QModel>{});
+    const Checkpoint& start, const ModelTraining& training_data,
+    const ModelTraining& verification, size_t batch_size,
+    const std::string& output) {
+  QTraining training = ResumeTraining(start);
   float loss = training.Loss(verification);
   LOG(INFO) << "Data size " << training_data.size() << " initial loss " << loss;
-  for (size_t generation = 1; loss > 0.026; ++generation) {
-    training = training.Generation(training_data, 0.0001);
+  for (uint64_t generation = start.generation + 1; loss > 0.026;
+       ++generation) {
+    training = training.Epoch(training_data, batch_size, 0.0001);
     loss = training.Loss(verification);
     LOG(INFO) << absl::Substitute("Generation $0 loss $1", generation, loss);
-    CHECK(WriteParameters(training.parameters(), oss,
-                          Game::QModel::kLayerIndexes));
-    if (generation > 50) {
+    Save(output, training, generation);
+    if (generation - start.generation > 50) {
       LOG(ERROR) << "Taking too long!";
     }
   }
@@ -284,6 +382,140 @@ uchen::ModelParameters<Game::QModel> TrainingLoop(
   return training.parameters();
 }
 
+// Every generation trains on a batch sampled from the buffer, the losses of
+// the batch become the new priorities of its transitions.
+uchen::ModelParameters<Game::QModel> PrioritizedTrainingLoop(
+    const Checkpoint& start, uchen::demo::ReplayBuffer& buffer,
+    const ModelTraining& verification, size_t batch_size,
+    const std::string& output) {
+  QTraining training = ResumeTraining(start);
+  std::mt19937 gen(absl::GetFlag(FLAGS_seed));
+  std::vector<float> losses;
+  float loss = training.Loss(verification);
+  LOG(INFO) << "Replay buffer size " << buffer.size() << " initial loss "
+            << loss;
+  for (uint64_t generation = start.generation + 1; loss > 0.026;
+       ++generation) {
+    std::vector indexes = buffer.Sample(batch_size, gen);
+    std::vector batch = buffer.Encode(indexes);
+    losses.resize(indexes.size());
+    training = training.Generation(
+        ModelTraining(std::make_move_iterator(batch.begin()),
+                      std::make_move_iterator(batch.end())),
+        0.0001, nullptr, losses);
+    buffer.UpdatePriorities(indexes, losses);
+    loss = training.Loss(verification);
+    LOG(INFO) << absl::Substitute("Generation $0 loss $1", generation, loss);
+    Save(output, training, generation);
+  }
+  LOG(INFO) << "Training finished, loss " << training.Loss(verification);
+  return training.parameters();
+}
+
+// Self-play and training at the same time instead of in turns. Actor threads
+// push the transitions of every finished batch of games into a queue. The
+// learner keeps the latest window of them in a replay buffer and, whenever new
+// transitions came in, runs a generation on a batch sampled from it. Only the
+// batch is encoded, the window holds the dots rather than the features.
+// Parameters of each generation are published with a pointer swap, actors
+// pick them up before their next batch.
+ModelParameters<Game::QModel> ActorLearnerLoop(const Checkpoint& start,
+                                               uint64_t seed, size_t window,
+                                               size_t batch_size,
+                                               size_t generations,
+                                               const std::string& output) {
+  using Transition = uchen::demo::DotGameReplay::Transition;
+  const uint32_t steps = absl::GetFlag(FLAGS_steps);
+  const float use_model = absl::GetFlag(FLAGS_model_play);
+  const size_t games = absl::GetFlag(FLAGS_games);
+  const size_t workers = absl::GetFlag(FLAGS_workers);
+  const size_t table_bits = absl::GetFlag(FLAGS_transposition_table_bits);
+  // Parameters with the positions evaluated with them. Every generation gets
+  // an empty table: actors still playing with the previous parameters keep
+  // writing to the previous one, clearing it would let their entries in.
+  struct Policy {
+    ModelParameters<Game::QModel> parameters;
+    uchen::demo::TranspositionTable table;
+  };
+  // A few batches, actors wait for the learner once it is full.
+  uchen::demo::MpmcQueue<Transition> queue(4 * batch_size);
+  std::atomic<std::shared_ptr<Policy>> published = std::make_shared<Policy>(
+      start.parameters, uchen::demo::TranspositionTable(table_bits));
+  std::atomic<bool> done = false;
+  auto actor = [&](size_t index) {
+    std::shared_ptr current = published.load();
+    uchen::demo::BatchInference inference(current->parameters);
+    for (size_t round = 0; !done; ++round) {
+      if (std::shared_ptr latest = published.load(); latest != current) {
+        current = std::move(latest);
+        inference.set_parameters(current->parameters);
+      }
+      uint64_t first_game = (round * workers + index) * games;
+      for (const auto& replay :
+           BatchSelfPlay(steps, inference, seed + first_game, use_model, games,
+                         current->table)) {
+        for (Transition& transition : replay.ToTransitions(0.1)) {
+          // Learner is behind, wait for it rather than drop the transition.
+          while (!queue.TryPush(std::move(transition))) {
+            if (done) {
+              return;
+            }
+            std::this_thread::yield();
+          }
+        }
+      }
+    }
+  };
+  std::vector<std::thread> actors;
+  for (size_t i = 0; i < workers; ++i) {
+    actors.emplace_back(actor, i);
+  }
+  QTraining training = ResumeTraining(start);
+  uchen::demo::ReplayBuffer buffer(window);
+  std::mt19937 gen(seed);
+  std::vector<float> losses;
+  size_t received = 0;
+  auto started = std::chrono::steady_clock::now();
+  for (uint64_t generation = start.generation + 1;
+       generation <= start.generation + generations;) {
+    size_t fresh = 0;
+    while (std::optional<Transition> transition = queue.TryPop()) {
+      buffer.Add(std::move(transition).value());
+      ++fresh;
+    }
+    if (fresh == 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    received += fresh;
+    std::vector indexes = buffer.Sample(batch_size, gen);
+    std::vector batch = buffer.Encode(indexes);
+    losses.resize(indexes.size());
+    training = training.Generation(
+        ModelTraining(std::make_move_iterator(batch.begin()),
+                      std::make_move_iterator(batch.end())),
+        0.0001, nullptr, losses);
+    buffer.UpdatePriorities(indexes, losses);
+    // Optimizer updates the parameters in place, actors get a copy.
+    published.store(std::make_shared<Policy>(
+        ModelParameters<Game::QModel>(
+            &Game::model, uchen::ParametersCopy(training.parameters())),
+        uchen::demo::TranspositionTable(table_bits)));
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - started;
+    LOG(INFO) << absl::Substitute(
+        "Generation $0 on $1 transitions ($2 new), $3 transitions/s",
+        generation, buffer.size(), fresh, received / elapsed.count());
+    Save(output, training, generation);
+    ++generation;
+  }
+  done = true;
+  for (std::thread& thread : actors) {
+    thread.join();
+  }
+  return training.parameters();
+}
+
 int main(int argc, char** argv) {
   auto l = absl::ParseCommandLine(argc, argv);
   absl::InitializeLog();
@@ -298,40 +530,55 @@ int main(int argc, char** argv) {
       LOG(FATAL) << "File name required";
       return 1;
     }
-    std::optional in_param = OpenFileForRead(absl::GetFlag(FLAGS_input_params));
-    if (!in_param.has_value()) {
+    std::optional start = LoadParameters(absl::GetFlag(FLAGS_input_params));
+    if (!start.has_value()) {
       return 1;
     }
-    std::optional par = ReadParameters(&Game::model, *in_param);
-    if (!par.has_value()) {
-      LOG(FATAL) << "Unable to read parameters";
+    const ModelParameters<Game::QModel>& par = start->parameters;
+    size_t games = absl::GetFlag(FLAGS_games);
+    size_t workers = absl::GetFlag(FLAGS_workers);
+    if (workers == 0) {
+      LOG(FATAL) << "At least one worker is required";
       return 1;
     }
+    if (games > 1 || workers > 1) {
+      if (absl::GetFlag(FLAGS_mcts_visits) > 0) {
+        LOG(FATAL) << "MCTS does not support batched self-play";
+        return 1;
+      }
+      int seed = absl::GetFlag(FLAGS_seed);
+      return ParallelSelfPlay(
+                 l.back(), absl::GetFlag(FLAGS_steps), par,
+                 seed != 0 ? seed : std::random_device{}(),
+                 absl::GetFlag(FLAGS_model_play), games, workers,
+                 absl::GetFlag(FLAGS_rounds))
+                 ? 0
+                 : 1;
+    }
     auto ofs = OpenFileForWrite(l.back(), absl::GetFlag(FLAGS_force));
     if (!ofs.has_value()) {
       return 1;
     }
+    uchen::demo::TranspositionTable table(
+        absl::GetFlag(FLAGS_transposition_table_bits));
     auto replay =
-        SelfPlay(absl::GetFlag(FLAGS_steps), *par, absl::GetFlag(FLAGS_seed),
-                 absl::GetFlag(FLAGS_model_play));
+        SelfPlay(absl::GetFlag(FLAGS_steps), par, absl::GetFlag(FLAGS_seed),
+                 absl::GetFlag(FLAGS_model_play), table);
     if (!replay.Write(*ofs)) {
       return 1;
     }
     return 0;
   } else if (verb == "init_parameters") {
-    auto ofs = OpenFileForWrite(absl::GetFlag(FLAGS_output_params),
-                                absl::GetFlag(FLAGS_force));
-    if (!ofs.has_value()) {
+    std::string output = absl::GetFlag(FLAGS_output_params);
+    if (!CanCreateFile(output)) {
       return 1;
     }
     auto parameters =
         uchen::training::KaimingHeInitializedParameters(&Game::model);
-    auto wrote = WriteParameters(
-        parameters, *ofs, std::make_index_sequence<Game::QModel::kLayers>());
-    if (!wrote.has_value()) {
+    if (!SaveCheckpoint(output, parameters, 0)) {
       return 1;
     }
-    LOG(INFO) << "Wrote " << *wrote << " bytes";
+    LOG(INFO) << "Wrote " << std::filesystem::file_size(output) << " bytes";
     return 0;
   } else if (verb == "train") {
     if (l.size() < 3) {
@@ -348,15 +595,36 @@ int main(int argc, char** argv) {
     if (!replays.has_value()) {
       return 1;
     }
-    std::optional in_param = OpenFileForRead(absl::GetFlag(FLAGS_input_params));
-    if (!in_param.has_value()) {
+    std::optional start = LoadParameters(absl::GetFlag(FLAGS_input_params));
+    if (!start.has_value()) {
       return 1;
     }
-    std::optional par = ReadParameters(&Game::model, *in_param);
-    if (!par.has_value()) {
-      LOG(FATAL) << "Unable to read parameters";
+    if (!CanCreateFile(result)) {
       return 1;
     }
+    if (size_t capacity = absl::GetFlag(FLAGS_replay_buffer); capacity > 0) {
+      uchen::demo::ReplayBuffer buffer(capacity);
+      training_set verification;
+      std::mt19937 gen(absl::GetFlag(FLAGS_seed));
+      std::bernoulli_distribution verify(0.2);
+      for (const auto& replay : *replays) {
+        for (auto& transition : replay.ToTransitions(0.1)) {
+          if (verify(gen)) {
+            verification.emplace_back(
+                uchen::demo::DotGameReplay::EncodeAsTensor(transition.first),
+                transition.second);
+          } else {
+            buffer.Add(std::move(transition));
+          }
+        }
+      }
+      PrioritizedTrainingLoop(
+          *start, buffer,
+          ModelTraining(std::make_move_iterator(verification.begin()),
+                        std::make_move_iterator(verification.end())),
+          absl::GetFlag(FLAGS_batch_size), result);
+      return 0;
+    }
     size_t turns = 0;
     for (const auto& replay : std::move(replays).value()) {
       turns += replay.turns();
@@ -375,15 +643,38 @@ int main(int argc, char** argv) {
             std::make_move_iterator(training_batch.end()))
             .Shuffle()
             .Split(0.8f);
+    uchen::ModelParameters params =
+        TrainingLoop(*start, training, verification,
+                     absl::GetFlag(FLAGS_batch_size), result);
 
-    std::optional out_params = OpenFileForWrite(
-        absl::GetFlag(FLAGS_output_params), absl::GetFlag(FLAGS_force));
-    if (!out_params.has_value()) {
+    return 0;
+  } else if (verb == "loop") {
+    if (absl::GetFlag(FLAGS_mcts_visits) > 0) {
+      LOG(FATAL) << "MCTS does not support batched self-play";
       return 1;
     }
-    uchen::ModelParameters params =
-        TrainingLoop(*par, training, verification, *out_params);
-
+    // The learner waits for samples from the actors.
+    if (absl::GetFlag(FLAGS_workers) == 0) {
+      LOG(FATAL) << "At least one worker is required";
+      return 1;
+    }
+    if (absl::GetFlag(FLAGS_batch_size) == 0) {
+      LOG(FATAL) << "Batch size must be positive";
+      return 1;
+    }
+    std::optional start = LoadParameters(absl::GetFlag(FLAGS_input_params));
+    if (!start.has_value()) {
+      return 1;
+    }
+    std::string output = absl::GetFlag(FLAGS_output_params);
+    if (!CanCreateFile(output)) {
+      return 1;
+    }
+    int seed = absl::GetFlag(FLAGS_seed);
+    ActorLearnerLoop(*start, seed != 0 ? seed : std::random_device{}(),
+                     absl::GetFlag(FLAGS_window),
+                     absl::GetFlag(FLAGS_batch_size),
+                     absl::GetFlag(FLAGS_generations), output);
     return 0;
   }
   std::cerr << "Unknown verb: " << verb;
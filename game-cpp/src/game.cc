@@ -2,30 +2,33 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <limits>
+#include <numeric>
 #include <optional>
 #include <random>
 #include <span>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "absl/log/check.h"
 #include "absl/log/log.h"
 
+#include "src/move_selection.h"
+
 namespace uchen::demo {
 namespace {
 
-using Polygon = Game::Polygon;
+using Polygon = GameBase::Polygon;
 using Direction = Polygon::Direction;
 
 constexpr std::array kNextDirection = {
-    Direction::kW, Direction::kNw, Direction::kN, Direction::kNe,
-    Direction::kE, Direction::kSe, Direction::kS, Direction::kSw,
-    Direction::kW, Direction::kNw, Direction::kN, Direction::kNe};
+    Direction::kW,  Direction::kNw, Direction::kN, Direction::kNe,
+    Direction::kE,  Direction::kSe, Direction::kS, Direction::kSw,
+    Direction::kW,  Direction::kNw, Direction::kN, Direction::kNe,
+    Direction::kE,  Direction::kSe};
 
 // Generators in C++23 will make this much better.
 absl::InlinedVector<size_t, 8> SurroundingIndexes(size_t index, size_t width,
@@ -47,132 +50,148 @@ absl::InlinedVector<size_t, 8> SurroundingIndexes(size_t index, size_t width,
   return indexes;
 }
 
-std::vector<Direction> OutlineRegion(size_t start_x, size_t start_y,
-                                     const Game::PlayerOverlay& overlay,
-                                     size_t height, size_t width,
-                                     std::vector<bool>& visited) {
+// Follows the boundary of the region clockwise from its top left cell. Dead
+// ends are left the way they were entered, so the walk always comes back.
+// Replaces the contents of the outline.
+void OutlineRegion(size_t start_x, size_t start_y,
+                   const GameBase::PlayerOverlay& overlay, uint16_t region,
+                   std::vector<Direction>& outline) {
+  size_t width = overlay.width();
+  size_t height = overlay.height();
   size_t x = start_x;
   size_t y = start_y;
-  std::vector<Direction> outline;
+  outline.clear();
   Direction dir = Direction::kE;
-  size_t max_steps = 5000;
+  // Every cell is entered at most once from each direction.
+  size_t max_steps = 8 * width * height;
   do {
-    if (max_steps-- == 0) {
-      LOG(FATAL) << "OutlineRegion: too many steps";
-      break;
-    }
+    CHECK_GT(max_steps--, 0) << "OutlineRegion: too many steps";
     std::span nextDirs = std::span<const Direction>(kNextDirection)
-                             .subspan(static_cast<size_t>(dir), 5);
+                             .subspan(static_cast<size_t>(dir), 7);
     for (auto d : nextDirs) {
       auto [dx, dy] = Polygon::kDirections[static_cast<size_t>(d)];
       size_t nx = x + dx;
       size_t ny = y + dy;
-      if (nx < 0 || nx >= width) {
-        continue;
-      }
-      if (ny < 0 || ny >= height) {
+      if (nx >= width || ny >= height) {
         continue;
       }
-      size_t nind = nx + ny * width;
-      if (overlay.get_dot(nind)) {
+      if (overlay.get_dot(nx + ny * width) == region) {
         dir = d;
         outline.push_back(d);
-        visited[nind] = true;
         x = nx;
         y = ny;
         break;
       }
     }
   } while (x != start_x || y != start_y);
-  return outline;
 }
 
-std::vector<Game::Polygon> UpdateRegions(const Game& game) {
-  std::vector<Game::Polygon> polygons;
-  int player_id = 0;
-  size_t size = game.field().size();
-  std::vector<bool> visited(size, false);
-  size_t width = game.width();
-  size_t height = size / width;
-  std::unordered_set<int> outlined_regions;
-  for (const auto& overlay : game.player_overlays()) {
-    std::fill(visited.begin(), visited.end(), false);
-    player_id += 1;
-    for (size_t i = 0; i < size; ++i) {
-      if (visited[i]) {
-        continue;
-      }
-      int region = overlay.get_dot(i);
-      if (region == 0 || outlined_regions.contains(region)) {
-        continue;
-      }
-      outlined_regions.insert(region);
-      polygons.push_back(Game::Polygon{
-          .x = i % width,
-          .y = i / width,
-          .outline = OutlineRegion(i % width, i / width, overlay, height, width,
-                                   visited),
-          .player = player_id,
-      });
-    }
+}  // namespace
+
+GameBase::DotConnectivity::DotConnectivity(size_t size)
+    : parent_(size), size_(size, 1) {
+  std::iota(parent_.begin(), parent_.end(), 0);
+}
+
+// No path compression, so lookups do not need to be journaled. Union by size
+// keeps the trees shallow.
+size_t GameBase::DotConnectivity::Find(size_t index) const {
+  while (parent_[index] != index) {
+    index = parent_[index];
   }
-  return polygons;
+  return index;
 }
 
-}  // namespace
+void GameBase::DotConnectivity::Join(size_t a, size_t b, Journal& journal) {
+  a = Find(a);
+  b = Find(b);
+  if (a == b) {
+    return;
+  }
+  if (size_[a] < size_[b]) {
+    std::swap(a, b);
+  }
+  journal.Record(Journal::Change::kJoin, 0, b, a);
+  parent_[b] = a;
+  size_[a] += size_[b];
+}
+
+void GameBase::DotConnectivity::Undo(const Journal::Entry& entry) {
+  DCHECK(entry.change == Journal::Change::kJoin);
+  size_[entry.value] -= size_[entry.index];
+  parent_[entry.index] = entry.index;
+}
 
-Game::Game(int height, int width)
+template <int W, int H>
+BasicGame<W, H>::BasicGame(int height, int width)
     : width_(width),
       field_(height * width, 0),
-      valid_moves_(height * width, Game::CellForMove::kFar) {
+      capturer_(height * width, 0),
+      connectivity_(height * width),
+      valid_moves_(height * width, CellForMove::kFar),
+      candidates_(height * width),
+      traversal_(height * width),
+      features_(2 * QModel::input_t::elements, 0) {
   CHECK_GT(height, 0);
   CHECK_GT(width, 0);
+  CHECK_LE(height, Bitboard::kRows);
+  CHECK_LE(width, Bitboard::kColumns);
+  CHECK_LE(height, QModel::input_t::height);
+  CHECK_LE(width, QModel::input_t::width);
 }
 
-bool Game::PlaceDot(size_t index, uint8_t player_id) {
-  valid_moves_[index] = CellForMove::kOccupied;
+template <int W, int H>
+bool BasicGame<W, H>::PlaceDot(size_t index, uint8_t player_id) {
+  polygon_update_.Clear();
+  set_move(index, CellForMove::kOccupied);
   if (player_at(index) != 0) {
     return false;
   }
   int x = index % width_;
   int y = index / width_;
+  journal_.Record(Journal::Change::kHash, 0, 0, hash_);
   set_dot(x, y, player_id);
+  player_overlay(player_id).add_dot(index, journal_);
   bool filled_polygon = FillPolygons(x, y);
-  if (filled_polygon) {
-    return false;
-    polygons_ = UpdateRegions(*this);
-  }
-  for (int kx = std::max(x - Game::kGoodMoveRange, 0);
-       kx <= std::min(x + Game::kGoodMoveRange, width_ - 1); ++kx) {
-    for (int ky = std::max(y - Game::kGoodMoveRange, 0);
+  ConnectDot(index);
+  for (int kx = std::max(x - kGoodMoveRange, 0);
+       kx <= std::min(x + kGoodMoveRange, width_ - 1); ++kx) {
+    for (int ky = std::max(y - kGoodMoveRange, 0);
          ky <= std::min(y + kGoodMoveRange,
                         static_cast<int>(field_.size() / width_) - 1);
          ++ky) {
       size_t ind = kx + ky * width_;
       if (field_[ind] == 0 && valid_moves_[ind] == CellForMove::kFar) {
-        valid_moves_[ind] = CellForMove::kGood;
+        set_move(ind, CellForMove::kGood);
       }
     }
   }
   return filled_polygon;
 }
 
-absl::InlinedVector<size_t, 64 * 64> Game::PathBetween(
+template <int W, int H>
+std::span<const uint16_t> BasicGame<W, H>::PathBetween(
     size_t start, size_t end,
-    const std::set<std::pair<size_t, size_t>>& ignored_transitions) const {
+    absl::Span<const std::pair<size_t, size_t>> ignored_transitions) const {
+  if (start >= field_.size() || end >= field_.size()) {
+    return {};
+  }
   int player_id = player_at(start);
-  if (start >= field_.size() || end >= field_.size() || player_id == 0 ||
-      player_at(end) != player_id) {
+  if (player_id == 0 || player_at(end) != player_id) {
     return {};
   }
-  absl::InlinedVector<std::optional<size_t>, kBufferSize> previous(
-      field_.size(), std::nullopt);
-  previous[start] = std::numeric_limits<size_t>::max();
+  auto ignored = [&](size_t a, size_t b) {
+    return std::any_of(ignored_transitions.begin(), ignored_transitions.end(),
+                       [a, b](const std::pair<size_t, size_t>& transition) {
+                         return transition == std::pair(a, b) ||
+                                transition == std::pair(b, a);
+                       });
+  };
   const size_t height = field_.size() / width_;
-  std::deque<size_t> to_visit = {start};
-  while (!to_visit.empty()) {
-    size_t index = to_visit.front();
-    to_visit.pop_front();
+  traversal_.Start();
+  traversal_.Visit(start, start);
+  while (!traversal_.empty()) {
+    uint16_t index = traversal_.Pop();
     for (size_t ni : SurroundingIndexes(index, width_, height)) {
       if (player_at(ni) != player_id) {
         continue;
@@ -180,44 +199,66 @@ absl::InlinedVector<size_t, 64 * 64> Game::PathBetween(
       if (Captured(ni)) {
         continue;
       }
-      if (ignored_transitions.contains({index, ni}) ||
-          ignored_transitions.contains({ni, index})) {
+      if (ignored(index, ni)) {
         continue;
       }
       if (ni == end) {
-        absl::InlinedVector<size_t, 64 * 64> result = {ni};
-        for (size_t i = index; i != std::numeric_limits<size_t>::max();
-             i = previous[i].value()) {
-          result.push_back(i);
-        }
-        std::reverse(result.begin(), result.end());
-        return result;
-      }
-      if (previous[ni].has_value()) {
-        continue;
+        return traversal_.Path(start, index, end);
       }
-      to_visit.push_back(ni);
-      previous[ni] = index;
+      traversal_.Visit(ni, index);
     }
   }
   return {};
 }
 
-bool Game::FillPolygons(int x, int y) {
+template <int W, int H>
+void BasicGame<W, H>::ConnectDot(size_t index) {
+  int player = player_at(index);
+  for (size_t ni : SurroundingIndexes(index, width_, field_.size() / width_)) {
+    if (player_at(ni) == player) {
+      connectivity_.Join(index, ni, journal_);
+    }
+  }
+}
+
+template <int W, int H>
+bool BasicGame<W, H>::FillPolygons(int x, int y) {
   size_t index = x + y * width_;
   CHECK_LT(index, field_.size());
   int player = player_at(index);
   CHECK_NE(player, 0);
-  // We "break" connections so we don't report same polygons repeatedly.
-  std::set<std::pair<size_t, size_t>> ignored_transitions;
-  bool updated = false;
+  // Neighbors that a path may go through, with their connectivity roots. The
+  // new dot is not connected to anything yet.
+  absl::InlinedVector<std::pair<size_t, size_t>, 8> neighbors;
   for (size_t ni :
        SurroundingIndexes(x + y * width_, width_, field_.size() / width_)) {
-    if (player_at(ni) != player) {
+    if (player_at(ni) == player && !Captured(ni)) {
+      neighbors.emplace_back(ni, connectivity_.Find(ni));
+    }
+  }
+  // We "break" connections so we don't report same polygons repeatedly.
+  absl::InlinedVector<std::pair<size_t, size_t>, 8> ignored_transitions;
+  bool updated = false;
+  for (size_t i = 0; i < neighbors.size(); ++i) {
+    auto [ni, root] = neighbors[i];
+    ignored_transitions.emplace_back(index, ni);
+    // Path has to leave through one of the remaining neighbors, so there is
+    // no loop unless one of them is connected to this one.
+    std::span remaining = std::span(neighbors).subspan(i + 1);
+    if (std::none_of(remaining.begin(), remaining.end(),
+                     [root](const auto& n) { return n.second == root; })) {
       continue;
     }
-    ignored_transitions.emplace(index, ni);
-    auto path = PathBetween(index, ni, ignored_transitions);
+    // Shortest path through a neighbor right next to this one is a triangle
+    // that does not enclose anything.
+    if (std::any_of(
+            remaining.begin(), remaining.end(),
+            [ni, this](const auto& n) { return Adjacent(ni, n.first); })) {
+      updated = true;
+      continue;
+    }
+    std::span<const uint16_t> path =
+        PathBetween(index, ni, ignored_transitions);
     if (path.empty()) {
       continue;
     }
@@ -227,145 +268,385 @@ bool Game::FillPolygons(int x, int y) {
   return updated;
 }
 
-void Game::FillPath(std::span<const size_t> path, int player_id) {
+template <int W, int H>
+void BasicGame<W, H>::FillPath(std::span<const uint16_t> path, int player_id) {
   size_t top = std::numeric_limits<size_t>::max(), bottom = 0,
          left = std::numeric_limits<size_t>::max(), right = 0;
+  Bitboard walls;
   for (size_t i : path) {
     top = std::min(top, i / width_);
     bottom = std::max(bottom, i / width_);
     left = std::min(left, i % width_);
     right = std::max(right, i % width_);
+    walls.set(i % width_, i / width_);
   }
-  size_t w = right - left + 1;
-  size_t h = bottom - top + 1;
-  Game::Grid grid(left, top, w, h);
-  // 1. Fill edges with outside.
-  for (size_t i : path) {
-    grid.mark_inside((i / width_ - top) * w + (i % width_ - left));
-  }
-  // 2. Mark outside.
-  std::deque<size_t> to_visit;
-  for (size_t x = 0; x < w; ++x) {
-    to_visit.push_back(x);
-    to_visit.push_back(x + (bottom - top) * w);
-  }
-  for (size_t y = 0; y < bottom - top + 1; ++y) {
-    to_visit.push_back(y * w);
-    to_visit.push_back(y * w + (right - left));
-  }
-  while (!to_visit.empty()) {
-    size_t index = to_visit.front();
-    to_visit.pop_front();
-    if (!grid.is_unknown(index)) {
-      continue;
-    }
-    grid.mark_outside(index);
-    size_t x = index % w;
-    size_t y = index / w;
-    if (x > 0) {
-      to_visit.push_back(index - 1);
-    }
-    if (x < right - left) {
-      to_visit.push_back(index + 1);
+  Enclosure enclosure = {
+      .bounding_box = Bitboard::Rectangle(left, top, right, bottom)};
+  Bitboard open = enclosure.bounding_box - walls;
+  // Outside spreads from the open cells on the edges of the bounding box.
+  Bitboard edges;
+  uint64_t sides = (uint64_t{1} << left) | (uint64_t{1} << right);
+  for (size_t y = top; y <= bottom; ++y) {
+    edges.row(y) = y == top || y == bottom ? ~uint64_t{0} : sides;
+  }
+  Bitboard outside = Bitboard::Flood(edges, open, top, bottom);
+  enclosure.enclosed = enclosure.bounding_box - outside;
+  enclosure.interior = enclosure.enclosed - walls;
+  PlayerOverlay& overlay = player_overlay(player_id);
+  uint16_t next_region_id = overlay.next_region_id();
+  overlay.MarkRegion(enclosure, OpponentDots(player_id), journal_)
+      .ForEach([&](size_t x, size_t y) {
+        size_t index = x + y * width_;
+        hash_ ^= ZobristKey(ZobristKind::kCaptured, player_id, index);
+        SetFeature(Feature::kOwnCaptured, player_id, index, 1);
+        if (capturer_[index] == 0) {
+          journal_.Record(Journal::Change::kCapturer, 0, index, 0);
+          capturer_[index] = player_id;
+        }
+      });
+  if (overlay.next_region_id() != next_region_id) {
+    UpdatePolygons(player_id, enclosure);
+  }
+}
+
+template <int W, int H>
+void BasicGame<W, H>::UpdatePolygons(int player_id,
+                                     const Enclosure& enclosure) {
+  PlayerOverlay& overlay = overlays_[player_id - 1];
+  overlay.FlattenRegions(journal_);
+  size_t top = 0;
+  while (enclosure.enclosed.row(top) == 0) {
+    ++top;
+  }
+  size_t start = std::countr_zero(enclosure.enclosed.row(top)) + top * width_;
+  uint16_t region = overlay.get_dot(start);
+  // Polygons start at the top left cell of their regions, so the merged
+  // region starts at one of them or at the new enclosure.
+  std::vector<size_t>& merged = merged_slots_;
+  merged.clear();
+  for (size_t slot = 0; slot < polygons_.size(); ++slot) {
+    const Polygon& polygon = polygons_[slot];
+    size_t polygon_start = polygon.x + polygon.y * width_;
+    if (polygon.player == player_id &&
+        overlay.get_dot(polygon_start) == region) {
+      merged.push_back(slot);
+      start = std::min(start, polygon_start);
     }
-    if (y > 0) {
-      to_visit.push_back(index - w);
+  }
+  Polygon polygon = {.x = start % width_,
+                     .y = start / width_,
+                     .outline = SpareOutline(),
+                     .player = player_id};
+  OutlineRegion(polygon.x, polygon.y, overlay, region, polygon.outline);
+  // Polygons added earlier in the same move are still reported as added.
+  auto contains = [](const std::vector<uint32_t>& ids, uint32_t id) {
+    return std::find(ids.begin(), ids.end(), id) != ids.end();
+  };
+  if (merged.empty()) {
+    journal_.Record(Journal::Change::kNextPolygonId, 0, 0, next_polygon_id_);
+    polygon.id = next_polygon_id_++;
+    polygon_update_.added.push_back(polygon.id);
+    SetPolygon(polygons_.size(), std::move(polygon));
+    return;
+  }
+  size_t kept = *std::min_element(
+      merged.begin(), merged.end(), [this](size_t a, size_t b) {
+        return polygons_[a].id < polygons_[b].id;
+      });
+  polygon.id = polygons_[kept].id;
+  if (!contains(polygon_update_.added, polygon.id) &&
+      !contains(polygon_update_.changed, polygon.id)) {
+    polygon_update_.changed.push_back(polygon.id);
+  }
+  SetPolygon(kept, std::move(polygon));
+  // Back to front, so the slots still to remove do not move.
+  for (auto it = merged.rbegin(); it != merged.rend(); ++it) {
+    if (*it == kept) {
+      continue;
     }
-    if (y < bottom - top) {
-      to_visit.push_back(index + w);
+    uint32_t id = polygons_[*it].id;
+    if (contains(polygon_update_.added, id)) {
+      std::erase(polygon_update_.added, id);
+    } else {
+      std::erase(polygon_update_.changed, id);
+      polygon_update_.removed.push_back(id);
     }
+    RemovePolygon(*it);
   }
-  player_overlay(player_id).MarkRegion(grid, *this);
 }
 
-bool Game::Captured(size_t index) const {
-  int id = player_at(index);
-  if (id == 0) {
-    return false;
+template <int W, int H>
+void BasicGame<W, H>::SetPolygon(size_t slot, Polygon polygon) {
+  bool replaced = slot < polygons_.size();
+  journal_.Record(Journal::Change::kPolygon, 0, slot, replaced);
+  if (!replaced) {
+    polygons_.push_back(std::move(polygon));
+    return;
+  }
+  if (journal_.recording()) {
+    retired_polygons_.push_back(std::move(polygons_[slot]));
+  } else {
+    Recycle(polygons_[slot]);
+  }
+  polygons_[slot] = std::move(polygon);
+}
+
+template <int W, int H>
+void BasicGame<W, H>::RemovePolygon(size_t slot) {
+  if (slot + 1 != polygons_.size()) {
+    // Copied, the last polygon is retired as well.
+    const Polygon& last = polygons_.back();
+    Polygon copy = {.x = last.x,
+                    .y = last.y,
+                    .outline = SpareOutline(),
+                    .player = last.player,
+                    .id = last.id};
+    copy.outline.assign(last.outline.begin(), last.outline.end());
+    SetPolygon(slot, std::move(copy));
   }
+  journal_.Record(Journal::Change::kPolygonRemoved, 0, polygons_.size() - 1,
+                  0);
+  if (journal_.recording()) {
+    retired_polygons_.push_back(std::move(polygons_.back()));
+  } else {
+    Recycle(polygons_.back());
+  }
+  polygons_.pop_back();
+}
+
+template <int W, int H>
+std::vector<GameBase::Polygon::Direction> BasicGame<W, H>::SpareOutline() {
+  if (spare_outlines_.empty()) {
+    // An outline rarely gets longer than the number of cells, reserving that
+    // much lets the buffer serve any later polygon.
+    std::vector<Polygon::Direction> outline;
+    outline.reserve(field_.size());
+    return outline;
+  }
+  std::vector<Polygon::Direction> outline = std::move(spare_outlines_.back());
+  spare_outlines_.pop_back();
+  return outline;
+}
+
+template <int W, int H>
+void BasicGame<W, H>::Recycle(Polygon& polygon) {
+  if (polygon.outline.capacity() > 0) {
+    spare_outlines_.push_back(std::move(polygon.outline));
+  }
+}
+
+template <int W, int H>
+Bitboard BasicGame<W, H>::OpponentDots(int player_id) const {
+  Bitboard result;
   for (size_t i = 0; i < overlays_.size(); ++i) {
-    if (i == id - 1) {
-      continue;
-    }
-    if (overlays_[i].captured(index)) {
-      return true;
+    if (i != static_cast<size_t>(player_id - 1)) {
+      result |= overlays_[i].dots();
     }
   }
-  return false;
+  return result;
 }
 
-void Game::PlayerOverlay::MarkRegion(const Grid& grid, const Game& game) {
-  // 3. Fill inside, count captured dots.
-  std::vector<bool> data;
-  size_t captured = 0;
-  int left = grid.x();
-  int top = grid.y();
-  int w = grid.width();
-  int h = grid.height();
-  for (size_t y = 0; y < h; ++y) {
-    for (size_t x = 0; x < w; ++x) {
-      data.emplace_back(!grid.is_outside(x + y * w));
-      if (!grid.is_unknown(x + y * w)) {
-        continue;
-      }
-      size_t ind = x + left + (y + top) * width_;
-      int p = game.player_at(ind);
-      if (p != 0 && p != player_id_) {
-        set_captured(ind);
-        ++captured;
-      }
-    }
+Bitboard GameBase::PlayerOverlay::MarkRegion(const Enclosure& enclosure,
+                                             const Bitboard& opponent_dots,
+                                             Journal& journal) {
+  Bitboard captured = enclosure.interior & opponent_dots;
+  if (captured.empty()) {
+    return captured;
   }
-  if (captured == 0) {
-    return;
+  Bitboard newly_captured = captured - captured_;
+  for (size_t y = 0; y < Bitboard::kRows; ++y) {
+    if ((captured_.row(y) | captured.row(y)) != captured_.row(y)) {
+      journal.Record(Journal::Change::kCaptured, player_id_ - 1, y,
+                     captured_.row(y));
+      captured_count_ += std::popcount(captured.row(y) & ~captured_.row(y));
+      captured_.row(y) |= captured.row(y);
+    }
   }
-  std::unordered_set<int> regions_to_merge;
-  int new_region_id = next_region_id_++;
-  for (size_t i = 0; i < data.size(); ++i) {
-    size_t index = i % w + left + (i / w + top) * width();
-    int region = get_dot(index);
-    if (region != 0) {
-      regions_to_merge.insert(region);
+  journal.Record(Journal::Change::kNextRegionId, player_id_ - 1, 0,
+                 next_region_id_);
+  uint16_t new_region_id = next_region_id_++;
+  CHECK_EQ(region_parent_.size(), new_region_id);
+  region_parent_.push_back(new_region_id);
+  // Regions in the bounding box are merged into the new one. Their cells
+  // outside the new region keep the old ids.
+  (regions_ & enclosure.bounding_box).ForEach([&](size_t x, size_t y) {
+    uint16_t root = get_dot(x + y * width_);
+    if (root != new_region_id && root < region_parent_.size()) {
+      journal.Record(Journal::Change::kRegionParent, player_id_ - 1, root,
+                     region_parent_[root]);
+      region_parent_[root] = new_region_id;
     }
-    if (data[i]) {
-      set_dot(index, new_region_id);
+  });
+  enclosure.enclosed.ForEach([&](size_t x, size_t y) {
+    size_t index = x + y * width_;
+    journal.Record(Journal::Change::kRegion, player_id_ - 1, index,
+                   data_[index]);
+    set_dot(index, new_region_id);
+  });
+  return newly_captured;
+}
+
+void GameBase::PlayerOverlay::FlattenRegions(Journal& journal) {
+  for (size_t id = 1; id < region_parent_.size(); ++id) {
+    uint16_t root = FindRegion(id);
+    if (region_parent_[id] != root) {
+      journal.Record(Journal::Change::kRegionParent, player_id_ - 1, id,
+                     region_parent_[id]);
+      region_parent_[id] = root;
     }
   }
-  if (regions_to_merge.empty()) {
-    return;
-  }
-  for (size_t i = 0; i < data_.size(); ++i) {
-    int region = get_dot(i);
-    if (region != 0 && regions_to_merge.contains(region)) {
-      set_dot(i, new_region_id);
-    }
+}
+
+void GameBase::PlayerOverlay::Undo(const Journal::Entry& entry) {
+  size_t x = entry.index % width_;
+  size_t y = entry.index / width_;
+  switch (entry.change) {
+    case Journal::Change::kDot:
+      dots_.reset(x, y);
+      break;
+    case Journal::Change::kRegion:
+      set_dot(entry.index, entry.value);
+      break;
+    case Journal::Change::kCaptured:
+      captured_count_ -=
+          std::popcount(captured_.row(entry.index) & ~entry.value);
+      captured_.row(entry.index) = entry.value;
+      break;
+    case Journal::Change::kNextRegionId:
+      next_region_id_ = entry.value;
+      region_parent_.resize(next_region_id_);
+      break;
+    case Journal::Change::kRegionParent:
+      region_parent_[entry.index] = entry.value;
+      break;
+    default:
+      LOG(FATAL) << "Not an overlay change: "
+                 << static_cast<int>(entry.change);
   }
 }
 
-std::vector<int> Game::GetGoodAutoplayerIndexes() const {
-  std::vector<int> indexes;
-  for (int i = 0; i < valid_moves_.size(); ++i) {
-    if (valid_moves_[i] == CellForMove::kGood) {
-      indexes.push_back(i);
+template <int W, int H>
+void BasicGame<W, H>::Rollback(size_t checkpoint) {
+  std::span entries = journal_.Since(checkpoint);
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    switch (it->change) {
+      case Journal::Change::kField:
+        SetFeature(Feature::kOwnDots, field_[it->index], it->index, 0);
+        SetFeature(Feature::kOwnDots, it->value, it->index, 1);
+        field_[it->index] = it->value;
+        break;
+      case Journal::Change::kCaptured: {
+        uint64_t row = overlays_[it->player].captured_cells().row(it->index);
+        for (uint64_t changed = row ^ it->value; changed != 0;
+             changed &= changed - 1) {
+          SetFeature(Feature::kOwnCaptured, it->player + 1,
+                     std::countr_zero(changed) + it->index * width_,
+                     (it->value >> std::countr_zero(changed)) & 1);
+        }
+        overlays_[it->player].Undo(*it);
+        break;
+      }
+      case Journal::Change::kMove:
+        UpdateCandidates(it->index, valid_moves_[it->index],
+                         static_cast<CellForMove>(it->value));
+        valid_moves_[it->index] = static_cast<CellForMove>(it->value);
+        break;
+      case Journal::Change::kJoin:
+        connectivity_.Undo(*it);
+        break;
+      case Journal::Change::kHash:
+        hash_ = it->value;
+        break;
+      case Journal::Change::kOverlay:
+        DCHECK_EQ(overlays_.size(), it->player + 1);
+        spare_overlays_.push_back(std::move(overlays_.back()));
+        overlays_.pop_back();
+        break;
+      case Journal::Change::kPolygon:
+        if (it->value == 0) {
+          DCHECK_EQ(polygons_.size(), it->index + 1);
+          Recycle(polygons_.back());
+          polygons_.pop_back();
+        } else {
+          Recycle(polygons_[it->index]);
+          polygons_[it->index] = std::move(retired_polygons_.back());
+          retired_polygons_.pop_back();
+        }
+        break;
+      case Journal::Change::kPolygonRemoved:
+        DCHECK_EQ(polygons_.size(), it->index);
+        polygons_.push_back(std::move(retired_polygons_.back()));
+        retired_polygons_.pop_back();
+        break;
+      case Journal::Change::kNextPolygonId:
+        next_polygon_id_ = it->value;
+        break;
+      case Journal::Change::kCapturer:
+        capturer_[it->index] = it->value;
+        break;
+      default:
+        overlays_[it->player].Undo(*it);
     }
   }
+  journal_.Close(checkpoint);
+  polygon_update_.Clear();
+}
+
+template <int W, int H>
+std::vector<int> BasicGame<W, H>::GetGoodAutoplayerIndexes() const {
+  std::vector<int> indexes(candidates_.items().begin(),
+                           candidates_.items().end());
   static thread_local std::mt19937 gen{std::random_device{}()};
   std::shuffle(indexes.begin(), indexes.end(), gen);
   return indexes;
 }
 
-size_t Game::SuggestMove(const ModelParameters<Game::QModel>& par) const {
-  QModel::input_t input;
-  auto output = model(input, par);
-  size_t r;
-  float max = -std::numeric_limits<float>::max();
-  for (size_t good_index : GetGoodAutoplayerIndexes()) {
-    if (output[good_index] > max) {
-      r = good_index;
-      max = output[good_index];
+template <int W, int H>
+typename BasicGame<W, H>::QModel::input_t BasicGame<W, H>::features(
+    uint8_t player) const {
+  using input_t = typename QModel::input_t;
+  CHECK(player == 1 || player == 2)
+      << "Unsupported player " << static_cast<int>(player);
+  // Model only reads its input.
+  float* data = const_cast<float*>(features_.data()) +
+                (player - 1) * input_t::elements;
+  return input_t(std::span<float, input_t::elements>(data, input_t::elements),
+                 nullptr);
+}
+
+template <int W, int H>
+std::optional<size_t> BasicGame<W, H>::SuggestMove(
+    uint8_t player, const ModelParameters<QModel>& par,
+    TranspositionTable* table) const {
+  if (table != nullptr) {
+    std::optional<TranspositionTable::Entry> cached =
+        table->Probe(position_key(player));
+    // Good moves depend on the move order, make sure the cached one is still
+    // available.
+    if (cached.has_value() && is_good_move(cached->move)) {
+      return cached->move;
     }
   }
-  return r;
+  if (candidates_.empty()) {
+    return std::nullopt;
+  }
+  auto output = model(features(player), par);
+  std::optional<size_t> best =
+      MaskedArgmax(output.data(), candidates_.mask());
+  // Only the best move and its Q-value are kept. All the Q-values of a 64x64
+  // board are 16KB, a slot is 16 bytes, and callers only need the best move.
+  if (table != nullptr && best.has_value()) {
+    table->Store(position_key(player),
+                 {.move = static_cast<uint16_t>(*best),
+                  .depth = 0,
+                  .bound = TranspositionTable::Bound::kExact,
+                  .value = output[*best]});
+  }
+  return best;
 }
 
+template class BasicGame<16, 16>;
+template class BasicGame<32, 32>;
+template class BasicGame<64, 64>;
+
 }  // namespace uchen::demo
\ No newline at end of file
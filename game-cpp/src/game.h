@@ -1,19 +1,26 @@
 #ifndef WASM_SRC_GAME_H
 #define WASM_SRC_GAME_H
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <optional>
 #include <ostream>
-#include <set>
+#include <random>
 #include <span>
 #include <type_traits>
-#include <unordered_set>
 #include <vector>
 
 #include "absl/container/inlined_vector.h"
+#include "absl/log/check.h"
+#include "absl/types/span.h"
 #include "absl/strings/substitute.h"
 
+#include "src/bitboard.h"
 #include "src/convolution.h"
+#include "src/transposition_table.h"
 #include "uchen/layers.h"
 #include "uchen/linear.h"
 
@@ -26,72 +33,194 @@ using uchen::convolution::ReluFilter;
 using uchen::layers::Linear;
 using uchen::layers::Relu;
 
-class Game {
- private:
+// Parts of the game that do not depend on the size of the board.
+class GameBase {
  public:
-  static constexpr size_t kBufferSize = 64 * 64;
   static constexpr int kGoodMoveRange = 2;
 
-  static constexpr uchen::Model model =
-      uchen::layers::Input<ConvolutionInput<4, 64, 64>> |
-      Conv2dWithFilter<16, 3, 3, 1, 1>(ReluFilter()) |
-      Conv2dWithFilter<32, 3, 3, 1, 1>(ReluFilter()) |
-      Conv2dWithFilter<32, 3, 3, 1, 1>(Flatten<ReluFilter>()) | Linear<128> |
-      Relu | Linear<64 * 64>;
-
-  using QModel = std::remove_const_t<decltype(model)>;
+  // Channels of the model input, as seen by one of the players.
+  enum class Feature : uint8_t {
+    kOwnDots = 0,
+    kOpponentDots = 1,
+    // Opponent dots captured by the player.
+    kOwnCaptured = 2,
+    kOpponentCaptured = 3,
+  };
 
-  class Grid {
+  // Changes made to the game while there are open checkpoints, in the order
+  // they were made. Only used to roll them back.
+  class Journal {
    public:
-    Grid(int x, int y, size_t w, size_t h)
-        : x_(x), y_(y), width_(w), height_(h), data_(w * h, State::kUnknown) {}
+    enum class Change : uint8_t {
+      // Value is the previous player at the index.
+      kField,
+      // Value is the previous CellForMove at the index.
+      kMove,
+      // Root at the index was joined to the root in value.
+      kJoin,
+      // Overlay was added for the player.
+      kOverlay,
+      // Player placed a dot at the index.
+      kDot,
+      // Value is the previous region id at the index.
+      kRegion,
+      // Index is the row of the captured cells, value is its previous bits.
+      kCaptured,
+      // Value is the previous next region id.
+      kNextRegionId,
+      // Value is the previous parent of the region id in the index.
+      kRegionParent,
+      // Value is the previous hash.
+      kHash,
+      // Polygon at the index was replaced or, if the index is past the end,
+      // added. Value is 1 if the replaced polygon is on top of the retired
+      // ones.
+      kPolygon,
+      // Last polygon, at the index, was removed and is on top of the retired
+      // ones.
+      kPolygonRemoved,
+      // Value is the previous next polygon id.
+      kNextPolygonId,
+      // Value is the previous capturer of the cell at the index.
+      kCapturer,
+    };
 
-    int width() const { return width_; }
-    int height() const { return height_; }
-    int x() const { return x_; }
-    int y() const { return y_; }
-    void mark_inside(size_t index) { data_[index] = State::kInside; }
-    void mark_outside(size_t index) { data_[index] = State::kOutside; }
-    bool is_unknown(size_t index) const {
-      return data_[index] == State::kUnknown;
+    struct Entry {
+      Change change;
+      uint8_t player;
+      uint16_t index;
+      uint64_t value;
+    };
+
+    bool recording() const { return checkpoints_ > 0; }
+
+    void Record(Change change, size_t player, size_t index, uint64_t value) {
+      if (recording()) {
+        entries_.push_back({.change = change,
+                            .player = static_cast<uint8_t>(player),
+                            .index = static_cast<uint16_t>(index),
+                            .value = value});
+      }
     }
-    bool is_outside(size_t index) const {
-      return data_[index] == State::kOutside;
+
+    size_t Open() {
+      ++checkpoints_;
+      return entries_.size();
+    }
+
+    std::span<const Entry> Since(size_t checkpoint) const {
+      return std::span(entries_).subspan(checkpoint);
+    }
+
+    void Close(size_t checkpoint) {
+      CHECK_GT(checkpoints_, 0);
+      CHECK_LE(checkpoint, entries_.size());
+      entries_.resize(checkpoint);
+      --checkpoints_;
     }
 
    private:
-    enum class State { kUnknown, kInside, kOutside };
+    std::vector<Entry> entries_;
+    size_t checkpoints_ = 0;
+  };
 
-    int x_, y_;
-    size_t width_, height_;
-    absl::InlinedVector<State, Game::kBufferSize> data_;
+  // Result of filling a closed path.
+  struct Enclosure {
+    Bitboard bounding_box;
+    // The path and everything inside it.
+    Bitboard enclosed;
+    // Cells strictly inside the path.
+    Bitboard interior;
   };
 
   class PlayerOverlay {
    public:
     PlayerOverlay(size_t w, size_t h, int player_id)
-        : width_(w), data_(h * w, 0), player_id_(player_id) {}
+        : width_(w),
+          data_(h * w, 0),
+          region_parent_(1, 0),
+          player_id_(player_id) {
+      CHECK_LE(w, Bitboard::kColumns);
+      CHECK_LE(h, Bitboard::kRows);
+    }
 
     int width() const { return width_; }
     int height() const { return data_.size() / width_; }
-    uint16_t get_dot(size_t index) const { return data_[index]; }
-    size_t captured_count() const { return captured_.size(); }
-    bool captured(size_t index) const { return captured_.contains(index); }
-    void set_dot(size_t index, uint16_t v) { data_[index] = v; }
-    void set_captured(size_t index) { captured_.emplace(index); }
+    int player_id() const { return player_id_; }
+    // Region id of the cell, 0 if it is not in a region.
+    uint16_t get_dot(size_t index) const {
+      return data_[index] == 0 ? 0 : FindRegion(data_[index]);
+    }
+    size_t captured_count() const { return captured_count_; }
+    // Id the next region will get, changes every time a region is marked.
+    uint16_t next_region_id() const { return next_region_id_; }
+    bool captured(size_t index) const {
+      return captured_.test(index % width_, index / width_);
+    }
+    bool has_dot(size_t index) const {
+      return dots_.test(index % width_, index / width_);
+    }
+    void set_dot(size_t index, uint16_t v) {
+      data_[index] = v;
+      if (v == 0) {
+        regions_.reset(index % width_, index / width_);
+      } else {
+        regions_.set(index % width_, index / width_);
+      }
+    }
+    void set_captured(size_t index) {
+      if (!captured(index)) {
+        captured_.set(index % width_, index / width_);
+        ++captured_count_;
+      }
+    }
+    void add_dot(size_t index, Journal& journal) {
+      journal.Record(Journal::Change::kDot, player_id_ - 1, index, 0);
+      dots_.set(index % width_, index / width_);
+    }
+
+    // Player's dots
+    const Bitboard& dots() const { return dots_; }
+    // Opponent's dots inside player's regions
+    const Bitboard& captured_cells() const { return captured_; }
+    // Cells that belong to any of player's regions
+    const Bitboard& regions() const { return regions_; }
+
+    // Returns the cells that were not captured before.
+    Bitboard MarkRegion(const Enclosure& enclosure,
+                        const Bitboard& opponent_dots, Journal& journal);
+
+    // Points every region id straight to its root, so get_dot() is O(1)
+    // until the next merge.
+    void FlattenRegions(Journal& journal);
 
-    void MarkRegion(const Grid& grid, const Game& game);
+    // Reverts a change this overlay recorded.
+    void Undo(const Journal::Entry& entry);
 
     friend bool operator==(const PlayerOverlay& a, const PlayerOverlay& b) {
-      return a.width_ == b.width_ && a.data_ == b.data_;
+      if (a.width_ != b.width_ || a.data_.size() != b.data_.size()) {
+        return false;
+      }
+      for (size_t i = 0; i < a.data_.size(); ++i) {
+        if (a.get_dot(i) != b.get_dot(i)) {
+          return false;
+        }
+      }
+      return true;
     }
 
     friend void AbslStringify(auto& sink, const PlayerOverlay& polygon) {
-      std::string data =
-          absl::StrJoin(polygon.data_, "", [](std::string* s, uint16_t data) {
-            absl::StrAppend(
-                s, data > 10 ? "x" : (data == 0 ? "." : absl::StrCat(data)));
-          });
+      std::string data;
+      for (size_t i = 0; i < polygon.data_.size(); ++i) {
+        uint16_t region = polygon.get_dot(i);
+        if (region > 10) {
+          data += "x";
+        } else if (region == 0) {
+          data += ".";
+        } else {
+          absl::StrAppend(&data, region);
+        }
+      }
       sink.Append(absl::Substitute(
           "($0x$1) |$2|", polygon.width_, polygon.data_.size() / polygon.width_,
           absl::StrJoin(absl::StrSplit(data, absl::ByLength(polygon.width_)),
@@ -105,13 +234,94 @@ class Game {
     }
 
    private:
+    // Merged regions are joined under the newest id, the same id the cells
+    // would get if they were all relabeled. Ids set directly with set_dot()
+    // are their own roots.
+    uint16_t FindRegion(uint16_t id) const {
+      while (id < region_parent_.size() && region_parent_[id] != id) {
+        id = region_parent_[id];
+      }
+      return id;
+    }
+
     size_t width_;
+    // Region ids as of the time cells were marked, use get_dot() for the
+    // current ones.
     std::vector<uint16_t> data_;
-    std::unordered_set<size_t> captured_;
+    // Union-find over region ids, index 0 is unused.
+    std::vector<uint16_t> region_parent_;
+    Bitboard dots_;
+    Bitboard captured_;
+    // Cells in captured_.
+    size_t captured_count_ = 0;
+    Bitboard regions_;
     uint16_t next_region_id_ = 1;
     int player_id_;
   };
 
+  // Union-find over the dots on the field. A dot is joined with its
+  // same-player neighbors when placed. Components are never split, even when
+  // dots get captured, so they may only be larger than the actual ones.
+  class DotConnectivity {
+   public:
+    explicit DotConnectivity(size_t size);
+
+    size_t Find(size_t index) const;
+    void Join(size_t a, size_t b, Journal& journal);
+
+    // Reverts a join. Joins need to be undone in reverse order.
+    void Undo(const Journal::Entry& entry);
+
+   private:
+    std::vector<uint16_t> parent_;
+    std::vector<uint16_t> size_;
+  };
+
+  // Cells that are good moves, in no particular order. Adding, removing and
+  // sampling are O(1).
+  class CandidateSet {
+   public:
+    explicit CandidateSet(size_t size)
+        : positions_(size, kAbsent), mask_((size + 63) / 64, 0) {
+      CHECK_LT(size, kAbsent);
+      items_.reserve(size);
+    }
+
+    bool contains(size_t index) const { return positions_[index] != kAbsent; }
+    bool empty() const { return items_.empty(); }
+    size_t size() const { return items_.size(); }
+    std::span<const uint16_t> items() const { return items_; }
+    // Bit i of word i / 64 is set for the cells in the set.
+    std::span<const uint64_t> mask() const { return mask_; }
+
+    void Add(size_t index) {
+      DCHECK(!contains(index));
+      positions_[index] = items_.size();
+      items_.push_back(index);
+      mask_[index / 64] |= uint64_t{1} << (index % 64);
+    }
+
+    // Last item takes the place of the removed one.
+    void Remove(size_t index) {
+      uint16_t position = positions_[index];
+      DCHECK_NE(position, kAbsent);
+      uint16_t last = items_.back();
+      items_[position] = last;
+      positions_[last] = position;
+      items_.pop_back();
+      positions_[index] = kAbsent;
+      mask_[index / 64] &= ~(uint64_t{1} << (index % 64));
+    }
+
+   private:
+    static constexpr uint16_t kAbsent = std::numeric_limits<uint16_t>::max();
+
+    std::vector<uint16_t> items_;
+    // Position of each cell in items_.
+    std::vector<uint16_t> positions_;
+    std::vector<uint64_t> mask_;
+  };
+
   struct Polygon {
     enum class Direction : uint8_t {
       kN = 0,
@@ -132,6 +342,9 @@ class Game {
     size_t x, y;
     std::vector<Direction> outline;
     int player;
+    // Stays the same while the region grows, so the UI can tell an updated
+    // polygon from a new one.
+    uint32_t id = 0;
 
     friend bool operator==(const Polygon& a, const Polygon& b) {
       return a.x == b.x && a.y == b.y && a.outline == b.outline &&
@@ -153,10 +366,144 @@ class Game {
     }
   };
 
-  Game(int height, int width);
+  // Polygon ids affected by the last PlaceDot().
+  struct PolygonUpdate {
+    std::vector<uint32_t> added;
+    std::vector<uint32_t> removed;
+    std::vector<uint32_t> changed;
+
+    // Keeps the buffers.
+    void Clear() {
+      added.clear();
+      removed.clear();
+      changed.clear();
+    }
+  };
+
+ protected:
+  enum class ZobristKind : uint64_t { kDot, kCaptured };
+  static constexpr uint64_t kSecondPlayerKey = 0x9e3779b97f4a7c15;
+
+  // Scratch space for the breadth-first search in PathBetween(), allocated
+  // once per game. Cells count as visited when their stamp matches the
+  // current generation, so starting a new search does not clear anything.
+  class Traversal {
+   public:
+    explicit Traversal(size_t size)
+        : stamps_(size, 0), previous_(size), queue_(size) {
+      CHECK_LE(size, std::numeric_limits<uint16_t>::max());
+      path_.reserve(size);
+    }
+
+    // Forgets the visited cells and empties the queue.
+    void Start() {
+      head_ = tail_ = 0;
+      if (++generation_ == 0) {
+        std::fill(stamps_.begin(), stamps_.end(), 0);
+        generation_ = 1;
+      }
+    }
+
+    // Queues the cell unless it was visited since the last Start().
+    void Visit(uint16_t index, uint16_t from) {
+      if (stamps_[index] == generation_) {
+        return;
+      }
+      stamps_[index] = generation_;
+      previous_[index] = from;
+      queue_[tail_++] = index;
+    }
+
+    bool empty() const { return head_ == tail_; }
+    uint16_t Pop() { return queue_[head_++]; }
+
+    // Fills the path with the cells from start to the end through the
+    // visited cell before it.
+    std::span<const uint16_t> Path(uint16_t start, uint16_t before_end,
+                                   uint16_t end) {
+      path_.clear();
+      path_.push_back(end);
+      for (uint16_t i = before_end; i != start; i = previous_[i]) {
+        path_.push_back(i);
+      }
+      path_.push_back(start);
+      std::reverse(path_.begin(), path_.end());
+      return path_;
+    }
+
+   private:
+    uint32_t generation_ = 0;
+    std::vector<uint32_t> stamps_;
+    std::vector<uint16_t> previous_;
+    // Every cell is queued at most once.
+    std::vector<uint16_t> queue_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    std::vector<uint16_t> path_;
+  };
+
+  // SplitMix64 of the cell, player and kind. Cheaper than a table of random
+  // keys that would not fit into L1 anyway.
+  static uint64_t ZobristKey(ZobristKind kind, size_t player, size_t index) {
+    uint64_t z = (index << 10 | player << 1 | static_cast<uint64_t>(kind)) *
+                     0x9e3779b97f4a7c15 +
+                 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+};
+
+// Game on a board of up to W x H cells. Buffers and the model input are sized
+// for the whole board at compile time, smaller boards leave the rest unused.
+template <int W, int H>
+class BasicGame : public GameBase {
+  static_assert(W > 0 && W <= Bitboard::kColumns);
+  static_assert(H > 0 && H <= Bitboard::kRows);
 
+ public:
+  static constexpr size_t kBufferSize = W * H;
+
+  static constexpr uchen::Model model =
+      uchen::layers::Input<ConvolutionInput<4, H, W>> |
+      Conv2dWithFilter<16, 3, 3, 1, 1>(ReluFilter()) |
+      Conv2dWithFilter<32, 3, 3, 1, 1>(ReluFilter()) |
+      Conv2dWithFilter<32, 3, 3, 1, 1>(Flatten<ReluFilter>()) | Linear<128> |
+      Relu | Linear<W * H>;
+
+  using QModel = std::remove_const_t<decltype(model)>;
+
+  // Position of the cell value in the model input.
+  static constexpr size_t FeatureOffset(Feature feature, size_t x, size_t y) {
+    return static_cast<size_t>(feature) +
+           (x + y * QModel::input_t::width) * QModel::input_t::channels;
+  }
+
+  explicit BasicGame(int height = H, int width = W);
+
+  // Shuffled copy of good_moves().
   std::vector<int> GetGoodAutoplayerIndexes() const;
 
+  // Empty cells near the dots, in no particular order.
+  std::span<const uint16_t> good_moves() const { return candidates_.items(); }
+  // Same as good_moves(), as a bitmask for the move selection functions.
+  std::span<const uint64_t> good_move_mask() const {
+    return candidates_.mask();
+  }
+  bool is_good_move(size_t index) const {
+    return index < valid_moves_.size() && candidates_.contains(index);
+  }
+
+  // Uniformly random good move, nullopt if there are none.
+  template <typename Gen>
+  std::optional<size_t> SampleGoodMove(Gen& gen) const {
+    if (candidates_.empty()) {
+      return std::nullopt;
+    }
+    std::uniform_int_distribution<size_t> dis(0, candidates_.size() - 1);
+    return candidates_.items()[dis(gen)];
+  }
+
   /* Returns true if regions were updated */
   bool PlaceDot(size_t index, uint8_t player_id);
 
@@ -169,19 +516,54 @@ class Game {
   }
   size_t width() const { return width_; }
 
-  // Exposed for tests
-  absl::InlinedVector<size_t, kBufferSize> PathBetween(
+  // Zobrist hash of the dots and the captured cells. Same positions reached
+  // through different move orders hash the same.
+  uint64_t hash() const { return hash_; }
+
+  // Transposition table key, the hash with the player to move. Same dots with
+  // the other player to move are a different position.
+  uint64_t position_key(uint8_t player) const {
+    return player == 2 ? hash_ ^ kSecondPlayerKey : hash_;
+  }
+
+  // Dots are in the same group of connected dots of one player. Groups are
+  // never split, so they may include dots that were captured since.
+  bool Connected(size_t a, size_t b) const {
+    return connectivity_.Find(a) == connectivity_.Find(b);
+  }
+
+  // Exposed for tests. The path is only valid until the next call. Uses
+  // scratch space of the game, so it is not safe to call from several threads
+  // at once.
+  std::span<const uint16_t> PathBetween(
       size_t start, size_t end,
-      const std::set<std::pair<size_t, size_t>>& ignored_transitions = {})
+      absl::Span<const std::pair<size_t, size_t>> ignored_transitions = {})
       const;
 
+  // Returns true if the dot closed any loops, even if nothing was captured.
+  // Expects the dot at x, y to not be connected with its neighbors yet.
   bool FillPolygons(int x, int y);
 
+  // Starts recording the changes. Rollback() with the returned value brings
+  // the game back to the current state, at the cost proportional to the number
+  // of changes made since. Checkpoints can be nested but need to be rolled
+  // back in reverse order. Nothing is recorded without open checkpoints.
+  size_t Checkpoint() { return journal_.Open(); }
+  void Rollback(size_t checkpoint);
+
   PlayerOverlay& player_overlay(int player_id) ABSL_ATTRIBUTE_LIFETIME_BOUND {
     size_t pip = player_id - 1;
     while (overlays_.size() <= pip) {
-      overlays_.emplace_back(width_, field_.size() / width_,
-                             overlays_.size() + 1);
+      journal_.Record(Journal::Change::kOverlay, overlays_.size(), 0, 0);
+      if (!spare_overlays_.empty() &&
+          static_cast<size_t>(spare_overlays_.back().player_id()) ==
+              overlays_.size() + 1) {
+        overlays_.push_back(std::move(spare_overlays_.back()));
+        spare_overlays_.pop_back();
+      } else {
+        overlays_.emplace_back(width_, field_.size() / width_,
+                               overlays_.size() + 1);
+      }
     }
     return overlays_[pip];
   }
@@ -191,31 +573,141 @@ class Game {
     return overlays_;
   }
 
+  // Outlines of the captured regions, one per region.
   std::span<const Polygon> polygons() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
     return polygons_;
   }
 
-  size_t SuggestMove(const ModelParameters<Game::QModel>& par) const;
+  // Cleared by Rollback().
+  const PolygonUpdate& polygon_update() const ABSL_ATTRIBUTE_LIFETIME_BOUND {
+    return polygon_update_;
+  }
+
+  // Table is optional. Best move of positions found there is reused instead
+  // of running the model again. Returns nullopt if there are no good moves.
+  std::optional<size_t> SuggestMove(uint8_t player,
+                                    const ModelParameters<QModel>& par,
+                                    TranspositionTable* table = nullptr) const;
+
+  // Model input for the player, kept up to date as the dots are placed. Only
+  // valid until the next change to the game. Players 1 and 2 only.
+  typename QModel::input_t features(uint8_t player) const;
 
  private:
+  enum class CellForMove : uint8_t { kFar, kOccupied, kGood };
+
   int player_at(size_t index) const { return field_[index]; }
 
   void set_dot(int x, int y, uint8_t player_id) {
-    field_[y * width_ + x] = player_id;
+    size_t index = y * width_ + x;
+    journal_.Record(Journal::Change::kField, 0, index, field_[index]);
+    if (field_[index] != 0) {
+      hash_ ^= ZobristKey(ZobristKind::kDot, field_[index], index);
+    }
+    if (player_id != 0) {
+      hash_ ^= ZobristKey(ZobristKind::kDot, player_id, index);
+    }
+    SetFeature(Feature::kOwnDots, field_[index], index, 0);
+    SetFeature(Feature::kOwnDots, player_id, index, 1);
+    field_[index] = player_id;
   }
 
-  void FillPath(std::span<const size_t> path, int player_id);
+  // Sets the cell on the player's own plane and on the matching opponent plane
+  // of the other player.
+  void SetFeature(Feature own, uint8_t player, size_t index, float value) {
+    if (player == 0 || player > 2) {
+      return;
+    }
+    size_t x = index % width_;
+    size_t y = index / width_;
+    features_[(player - 1) * QModel::input_t::elements +
+              FeatureOffset(own, x, y)] = value;
+    features_[(2 - player) * QModel::input_t::elements +
+              FeatureOffset(static_cast<Feature>(static_cast<int>(own) + 1),
+                            x, y)] = value;
+  }
 
-  bool Captured(size_t index) const;
+  void set_move(size_t index, CellForMove move) {
+    journal_.Record(Journal::Change::kMove, 0, index,
+                    static_cast<uint64_t>(valid_moves_[index]));
+    UpdateCandidates(index, valid_moves_[index], move);
+    valid_moves_[index] = move;
+  }
+
+  void UpdateCandidates(size_t index, CellForMove from, CellForMove to) {
+    if (from == to) {
+      return;
+    }
+    if (from == CellForMove::kGood) {
+      candidates_.Remove(index);
+    } else if (to == CellForMove::kGood) {
+      candidates_.Add(index);
+    }
+  }
+
+  bool Adjacent(size_t a, size_t b) const {
+    int dx = static_cast<int>(a % width_) - static_cast<int>(b % width_);
+    int dy = static_cast<int>(a / width_) - static_cast<int>(b / width_);
+    return std::abs(dx) <= 1 && std::abs(dy) <= 1;
+  }
+
+  // Joins the newly placed dot with its same-player neighbors.
+  void ConnectDot(size_t index);
+
+  void FillPath(std::span<const uint16_t> path, int player_id);
+
+  // Retraces the outline of the region just created from the enclosure. It
+  // replaces the polygons of the regions merged into it, the oldest one keeps
+  // its id.
+  void UpdatePolygons(int player_id, const Enclosure& enclosure);
+  // Slot past the end adds a polygon.
+  void SetPolygon(size_t slot, Polygon polygon);
+  void RemovePolygon(size_t slot);
+  // Outline buffer of a dropped polygon or a new one.
+  std::vector<Polygon::Direction> SpareOutline();
+  // Keeps the outline buffer of a polygon that is about to be dropped.
+  void Recycle(Polygon& polygon);
+
+  bool Captured(size_t index) const { return capturer_[index] != 0; }
+
+  // Dots of all the players other than the given one.
+  Bitboard OpponentDots(int player_id) const;
 
   int width_;
   absl::InlinedVector<uint8_t, kBufferSize> field_;
+  // Player that captured the dot in the cell first, 0 if it is free.
+  absl::InlinedVector<uint8_t, kBufferSize> capturer_;
   std::vector<PlayerOverlay> overlays_;
+  // Overlays dropped by Rollback(). All of their changes were undone by then,
+  // so they are as good as new ones and keep their buffers.
+  std::vector<PlayerOverlay> spare_overlays_;
   std::vector<Polygon> polygons_;
-  enum class CellForMove { kFar, kOccupied, kGood };
+  // Polygons replaced while there are open checkpoints, restored by
+  // Rollback().
+  std::vector<Polygon> retired_polygons_;
+  // Outline buffers of dropped polygons. Polygons come and go with every
+  // rollback, reusing their buffers keeps playouts free of allocations.
+  std::vector<std::vector<Polygon::Direction>> spare_outlines_;
+  // Scratch space of UpdatePolygons(), slots of the polygons being merged.
+  std::vector<size_t> merged_slots_;
+  uint32_t next_polygon_id_ = 1;
+  PolygonUpdate polygon_update_;
+  DotConnectivity connectivity_;
   std::vector<CellForMove> valid_moves_;
+  CandidateSet candidates_;
+  mutable Traversal traversal_;
+  uint64_t hash_ = 0;
+  // Model inputs for players 1 and 2, one after another.
+  std::vector<float> features_;
+  Journal journal_;
 };
 
+extern template class BasicGame<16, 16>;
+extern template class BasicGame<32, 32>;
+extern template class BasicGame<64, 64>;
+
+using Game = BasicGame<64, 64>;
+
 };  // namespace uchen::demo
 
 #endif  // WASM_SRC_GAME_H
\ No newline at end of file
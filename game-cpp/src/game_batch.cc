@@ -0,0 +1,118 @@
+#include "src/game_batch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+
+#include "absl/log/check.h"
+
+#include "src/game.h"
+#include "src/move_selection.h"
+#include "src/transposition_table.h"
+
+namespace uchen::demo {
+namespace {
+
+// Good move with the highest Q-value, kNoMove if there are none.
+uint32_t BestMove(const Game& game, std::span<const float> q_values) {
+  std::optional<size_t> best = MaskedArgmax(q_values, game.good_move_mask());
+  return best.has_value() ? *best : GameBatch::kNoMove;
+}
+
+}  // namespace
+
+GameBatch::GameBatch(size_t games, int height, int width, uint64_t seed,
+                     TranspositionTable* table)
+    : players_(games, 2),
+      finished_(games, 0),
+      moves_(games, kNoMove),
+      cached_(games, kNoMove),
+      slots_(games, kNoMove),
+      table_(table),
+      active_(games) {
+  CHECK_GT(games, 0);
+  games_.reserve(games);
+  generators_.reserve(games);
+  inputs_.reserve(games);
+  for (size_t i = 0; i < games; ++i) {
+    Game& game = games_.emplace_back(height, width);
+    // Same first dot as the single game self-play, (31, 31) on 64x64.
+    game.PlaceDot((height - 1) / 2 * width + (width - 1) / 2, 1);
+    generators_.emplace_back(seed + i);
+  }
+}
+
+std::span<const Game::QModel::input_t> GameBatch::Inputs() {
+  inputs_.clear();
+  for (size_t i = 0; i < games_.size(); ++i) {
+    const Game& game = games_[i];
+    cached_[i] = kNoMove;
+    slots_[i] = kNoMove;
+    if (table_ != nullptr) {
+      if (finished_[i]) {
+        continue;
+      }
+      // Good moves depend on the move order, the cached one may be gone.
+      std::optional<TranspositionTable::Entry> entry =
+          table_->Probe(game.position_key(players_[i]));
+      if (entry.has_value() && game.is_good_move(entry->move)) {
+        cached_[i] = entry->move;
+        continue;
+      }
+    }
+    slots_[i] = inputs_.size();
+    inputs_.push_back(game.features(players_[i]));
+  }
+  return inputs_;
+}
+
+std::span<const uint32_t> GameBatch::Step(std::span<const float> q_values,
+                                          float use_model) {
+  CHECK(q_values.empty() || q_values.size() == inputs_.size() * kOutputs)
+      << "Expected " << kOutputs << " Q-values per input, got "
+      << q_values.size();
+  std::uniform_real_distribution<float> is_model(0.f, 1.f);
+  for (size_t i = 0; i < games_.size(); ++i) {
+    moves_[i] = kNoMove;
+    if (finished_[i]) {
+      continue;
+    }
+    Game& game = games_[i];
+    std::mt19937& gen = generators_[i];
+    // Drawn for every move, so the games do not depend on the Q-values being
+    // there.
+    bool model_move = is_model(gen) < use_model;
+    if (model_move && cached_[i] != kNoMove) {
+      moves_[i] = cached_[i];
+    } else if (model_move && !q_values.empty() && slots_[i] != kNoMove) {
+      std::span<const float> q =
+          q_values.subspan(slots_[i] * kOutputs, kOutputs);
+      moves_[i] = BestMove(game, q);
+      if (table_ != nullptr && moves_[i] != kNoMove) {
+        table_->Store(game.position_key(players_[i]),
+                      {.move = static_cast<uint16_t>(moves_[i]),
+                       .depth = 0,
+                       .bound = TranspositionTable::Bound::kExact,
+                       .value = q[moves_[i]]});
+      }
+    } else if (std::optional<size_t> move = game.SampleGoodMove(gen)) {
+      moves_[i] = *move;
+    }
+    if (moves_[i] != kNoMove) {
+      game.PlaceDot(moves_[i], players_[i]);
+      players_[i] = 3 - players_[i];
+    }
+    if (game.good_moves().empty()) {
+      finished_[i] = 1;
+      --active_;
+    }
+  }
+  std::fill(cached_.begin(), cached_.end(), kNoMove);
+  std::fill(slots_.begin(), slots_.end(), kNoMove);
+  return moves_;
+}
+
+}  // namespace uchen::demo
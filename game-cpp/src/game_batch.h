@@ -0,0 +1,70 @@
+#ifndef SRC_GAME_BATCH_H
+#define SRC_GAME_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "src/game.h"
+#include "src/transposition_table.h"
+
+namespace uchen::demo {
+
+// Plays many independent games in lockstep, one dot per game per step, so the
+// model can evaluate the positions of all of them in a single batch. State of
+// the games is kept in parallel arrays indexed by the game.
+class GameBatch {
+ public:
+  static constexpr uint32_t kNoMove = std::numeric_limits<uint32_t>::max();
+  static constexpr size_t kOutputs = Game::QModel::output_t::elements;
+
+  // Every game starts with a dot of the first player in the middle of the
+  // board. Game i uses the seed + i for its moves, so it plays the same
+  // regardless of the size of the batch. Table is optional and may be shared
+  // with other batches, model moves of the positions found there are reused
+  // instead of evaluated.
+  GameBatch(size_t games, int height, int width, uint64_t seed,
+            TranspositionTable* table = nullptr);
+
+  size_t size() const { return games_.size(); }
+  const Game& game(size_t i) const { return games_[i]; }
+  // Player to move next in the game.
+  uint8_t player(size_t i) const { return players_[i]; }
+  // Games that still have moves left.
+  size_t active() const { return active_; }
+
+  // Model inputs for the players to move. Without a table there is one per
+  // game, finished games included, so the outputs line up with the games.
+  // With a table only the unfinished games whose position is not there are
+  // evaluated. Valid until Step().
+  std::span<const Game::QModel::input_t> Inputs();
+
+  // Places a dot in every unfinished game. With use_model probability it is
+  // the good move with the highest Q-value, otherwise a random good move.
+  // Q-values are kOutputs per input of the last Inputs(), in the same order,
+  // and may be empty when no game uses the model. Returns the move of each
+  // game, kNoMove for the finished ones.
+  std::span<const uint32_t> Step(std::span<const float> q_values,
+                                 float use_model);
+
+ private:
+  std::vector<Game> games_;
+  std::vector<uint8_t> players_;
+  std::vector<uint8_t> finished_;
+  std::vector<std::mt19937> generators_;
+  std::vector<uint32_t> moves_;
+  std::vector<Game::QModel::input_t> inputs_;
+  // Per game, set by Inputs() and used by the next Step(). Move from the
+  // table or the index of the game in the inputs, kNoMove if there is none.
+  std::vector<uint32_t> cached_;
+  std::vector<uint32_t> slots_;
+  TranspositionTable* table_;
+  size_t active_;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_GAME_BATCH_H
@@ -0,0 +1,238 @@
+#include "src/mcts.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+
+namespace uchen::demo {
+namespace {
+
+uint8_t Opponent(uint8_t player) { return 3 - player; }
+
+// Game is over when there are no moves left, the one with more captures
+// wins.
+float TerminalValue(const Game& game, uint8_t player) {
+  int64_t ours = game.player_score(player);
+  int64_t theirs = game.player_score(Opponent(player));
+  return ours > theirs ? 1 : (ours < theirs ? -1 : 0);
+}
+
+}  // namespace
+
+std::optional<uint32_t> Mcts::NodePool::Allocate(size_t count) {
+  size_t first = size_.fetch_add(count, std::memory_order_relaxed);
+  if (first + count > nodes_.size()) {
+    return std::nullopt;
+  }
+  for (size_t i = first; i < first + count; ++i) {
+    Node& node = nodes_[i];
+    node.visits.store(0, std::memory_order_relaxed);
+    node.value.store(0, std::memory_order_relaxed);
+    node.state.store(NodeState::kLeaf, std::memory_order_relaxed);
+    node.prior = 0;
+    node.move = 0;
+    node.children = 0;
+    node.first_child = 0;
+  }
+  return first;
+}
+
+Mcts::Mcts(Evaluator evaluator, Options options)
+    : evaluator_(std::move(evaluator)),
+      options_(options),
+      pool_(options.max_nodes) {
+  CHECK_GT(options_.threads, 0);
+  CHECK_GT(options_.max_nodes, Game::kBufferSize);
+}
+
+Mcts::Evaluator Mcts::QModelEvaluator(
+    const ModelParameters<Game::QModel>& par) {
+  return [&par](const Game& game, uint8_t player,
+                std::span<const uint16_t> moves, std::span<float> priors) {
+    auto output = Game::model(game.features(player), par);
+    float max = -std::numeric_limits<float>::max();
+    for (uint16_t move : moves) {
+      max = std::max(max, output[move]);
+    }
+    float sum = 0;
+    for (size_t i = 0; i < moves.size(); ++i) {
+      priors[i] = std::exp(output[moves[i]] - max);
+      sum += priors[i];
+    }
+    for (float& prior : priors) {
+      prior /= sum;
+    }
+    return std::tanh(max);
+  };
+}
+
+std::optional<size_t> Mcts::Search(const Game& game, uint8_t player,
+                                   Stats* stats) {
+  auto start = std::chrono::steady_clock::now();
+  pool_.Reset();
+  std::optional<uint32_t> root = pool_.Allocate(1);
+  CHECK(root.has_value());
+  simulations_.store(0, std::memory_order_relaxed);
+  pool_full_.store(false, std::memory_order_relaxed);
+  auto in_budget = [&]() {
+    // Budget in nanoseconds would overflow with the default value.
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start) <
+           options_.time_budget;
+  };
+  auto worker = [&]() {
+    Game local = game;
+    std::vector<uint32_t> path;
+    // Reserved for every cell, so expanding a node does not allocate.
+    std::vector<float> priors;
+    priors.reserve(Game::kBufferSize);
+    while (simulations_.fetch_add(1, std::memory_order_relaxed) <
+               options_.max_visits &&
+           !pool_full_.load(std::memory_order_relaxed) && in_budget()) {
+      Simulate(local, player, path, priors);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < options_.threads; ++i) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const Node& node = pool_[*root];
+  if (stats != nullptr) {
+    stats->visits = node.visits.load(std::memory_order_relaxed);
+    stats->nodes = pool_.size();
+    stats->elapsed = std::chrono::steady_clock::now() - start;
+  }
+  if (node.state.load(std::memory_order_acquire) != NodeState::kExpanded ||
+      node.children == 0) {
+    return std::nullopt;
+  }
+  uint32_t best = node.first_child;
+  for (uint32_t i = node.first_child + 1; i < node.first_child + node.children;
+       ++i) {
+    if (pool_[i].visits.load(std::memory_order_relaxed) >
+        pool_[best].visits.load(std::memory_order_relaxed)) {
+      best = i;
+    }
+  }
+  return pool_[best].move;
+}
+
+void Mcts::Simulate(Game& game, uint8_t player, std::vector<uint32_t>& path,
+                    std::vector<float>& priors) {
+  size_t checkpoint = game.Checkpoint();
+  path.clear();
+  path.push_back(0);
+  AddVirtualLoss(pool_[0]);
+  float value;
+  while (true) {
+    Node& node = pool_[path.back()];
+    NodeState state = node.state.load(std::memory_order_acquire);
+    if (state == NodeState::kExpanded) {
+      if (node.children == 0) {
+        value = TerminalValue(game, player);
+        break;
+      }
+      uint32_t child = SelectChild(node);
+      AddVirtualLoss(pool_[child]);
+      game.PlaceDot(pool_[child].move, player);
+      player = Opponent(player);
+      path.push_back(child);
+    } else if (state == NodeState::kLeaf &&
+               node.state.compare_exchange_strong(state,
+                                                  NodeState::kExpanding)) {
+      value = Expand(game, player, node, priors);
+      break;
+    } else {
+      // Another thread is expanding the node.
+      std::this_thread::yield();
+    }
+  }
+  Backup(path, value);
+  game.Rollback(checkpoint);
+}
+
+uint32_t Mcts::SelectChild(const Node& node) {
+  float sqrt_visits = std::sqrt(
+      std::max(node.visits.load(std::memory_order_relaxed), int32_t{1}));
+  uint32_t best = node.first_child;
+  float best_score = -std::numeric_limits<float>::max();
+  for (uint32_t i = node.first_child; i < node.first_child + node.children;
+       ++i) {
+    const Node& child = pool_[i];
+    int32_t visits = child.visits.load(std::memory_order_relaxed);
+    float q =
+        visits > 0 ? child.value.load(std::memory_order_relaxed) / visits : 0;
+    float score =
+        q + options_.exploration * child.prior * sqrt_visits / (1 + visits);
+    if (score > best_score) {
+      best = i;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+float Mcts::Expand(const Game& game, uint8_t player, Node& node,
+                   std::vector<float>& priors) {
+  std::span<const uint16_t> moves = game.good_moves();
+  if (moves.empty()) {
+    node.state.store(NodeState::kExpanded, std::memory_order_release);
+    return TerminalValue(game, player);
+  }
+  // Allocated first, an evaluation that can not grow the tree is wasted.
+  std::optional<uint32_t> first = pool_.Allocate(moves.size());
+  if (!first.has_value()) {
+    // Out of nodes, the tree can not grow any more. Search stops after this
+    // simulation, the value still counts.
+    pool_full_.store(true, std::memory_order_relaxed);
+    node.state.store(NodeState::kLeaf, std::memory_order_release);
+    priors.assign(moves.size(), 0);
+    return evaluator_(game, player, moves, priors);
+  }
+  priors.assign(moves.size(), 0);
+  float value = evaluator_(game, player, moves, priors);
+  for (size_t i = 0; i < moves.size(); ++i) {
+    Node& child = pool_[*first + i];
+    child.move = moves[i];
+    child.prior = priors[i];
+  }
+  node.first_child = *first;
+  node.children = moves.size();
+  node.state.store(NodeState::kExpanded, std::memory_order_release);
+  return value;
+}
+
+void Mcts::AddVirtualLoss(Node& node) {
+  node.visits.fetch_add(options_.virtual_loss, std::memory_order_relaxed);
+  node.value.fetch_sub(options_.virtual_loss, std::memory_order_relaxed);
+}
+
+void Mcts::Backup(std::span<const uint32_t> path, float value) {
+  // Last node is reached by the opponent of the player to move.
+  value = -value;
+  for (auto it = path.rbegin(); it != path.rend(); ++it) {
+    Node& node = pool_[*it];
+    node.visits.fetch_add(1 - options_.virtual_loss,
+                          std::memory_order_relaxed);
+    node.value.fetch_add(value + options_.virtual_loss,
+                         std::memory_order_relaxed);
+    value = -value;
+  }
+}
+
+}  // namespace uchen::demo
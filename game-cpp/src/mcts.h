@@ -0,0 +1,127 @@
+#ifndef SRC_MCTS_H
+#define SRC_MCTS_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "src/game.h"
+
+namespace uchen::demo {
+
+// Monte Carlo tree search over Game positions. Children are selected with
+// PUCT using the priors from the evaluator. Search threads share one tree
+// and add virtual loss along the path they descend so they spread over
+// different branches.
+class Mcts {
+ public:
+  // Fills in the priors of the moves and returns the value of the position
+  // for the player to move, in [-1, 1]. Called from all the search threads at
+  // once.
+  using Evaluator =
+      std::function<float(const Game& game, uint8_t player,
+                          std::span<const uint16_t> moves,
+                          std::span<float> priors)>;
+
+  struct Options {
+    size_t threads = 1;
+    // Search stops after this many simulations or when the time budget runs
+    // out, whichever happens first.
+    size_t max_visits = 800;
+    std::chrono::milliseconds time_budget = std::chrono::milliseconds::max();
+    // Size of the node pool, search stops when it is used up.
+    size_t max_nodes = 1 << 20;
+    float exploration = 1.5f;
+    // Number of lost visits added to the nodes on the path of a simulation
+    // while it is in flight.
+    int virtual_loss = 3;
+  };
+
+  struct Stats {
+    size_t visits = 0;
+    size_t nodes = 0;
+    std::chrono::nanoseconds elapsed{0};
+
+    double nodes_per_second() const {
+      return elapsed.count() == 0 ? 0 : nodes * 1e9 / elapsed.count();
+    }
+  };
+
+  Mcts(Evaluator evaluator, Options options);
+
+  // Priors are the softmax of the Q-values of the moves, the value is the
+  // largest Q-value squashed with tanh. Parameters must outlive the evaluator.
+  static Evaluator QModelEvaluator(const ModelParameters<Game::QModel>& par);
+
+  // Returns the most visited move or nullopt if the player has no moves.
+  // Tree is rebuilt from scratch for every call, one search at a time.
+  std::optional<size_t> Search(const Game& game, uint8_t player,
+                               Stats* stats = nullptr);
+
+ private:
+  enum class NodeState : uint8_t { kLeaf, kExpanding, kExpanded };
+
+  struct Node {
+    // Visits and total value are from the point of view of the player that
+    // made the move leading to this node.
+    std::atomic<int32_t> visits = 0;
+    std::atomic<float> value = 0;
+    std::atomic<NodeState> state = NodeState::kLeaf;
+    float prior = 0;
+    uint16_t move = 0;
+    // Children are allocated next to each other. Only read after the state
+    // becomes kExpanded.
+    uint16_t children = 0;
+    uint32_t first_child = 0;
+  };
+
+  // Nodes for the tree, allocated once and reused between searches.
+  class NodePool {
+   public:
+    explicit NodePool(size_t capacity) : nodes_(capacity) {}
+
+    // Returns the index of the first of count new nodes or nullopt if the
+    // pool is used up.
+    std::optional<uint32_t> Allocate(size_t count);
+    void Reset() { size_.store(0, std::memory_order_relaxed); }
+    size_t size() const {
+      return std::min(size_.load(std::memory_order_relaxed), nodes_.size());
+    }
+
+    Node& operator[](uint32_t index) { return nodes_[index]; }
+
+   private:
+    std::vector<Node> nodes_;
+    std::atomic<size_t> size_ = 0;
+  };
+
+  // Plays one simulation from the root and rolls the game back. Path and
+  // priors are scratch space of the calling thread.
+  void Simulate(Game& game, uint8_t player, std::vector<uint32_t>& path,
+                std::vector<float>& priors);
+  uint32_t SelectChild(const Node& node);
+  // Evaluates the position and adds the children to the node. Returns the
+  // value for the player to move. Leaves the node a leaf and sets pool_full_
+  // when there is no room for the children.
+  float Expand(const Game& game, uint8_t player, Node& node,
+               std::vector<float>& priors);
+  void AddVirtualLoss(Node& node);
+  // Value is for the player to move after the last node of the path.
+  void Backup(std::span<const uint32_t> path, float value);
+
+  Evaluator evaluator_;
+  Options options_;
+  NodePool pool_;
+  std::atomic<size_t> simulations_ = 0;
+  std::atomic<bool> pool_full_ = false;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_MCTS_H
@@ -0,0 +1,334 @@
+#include "src/move_selection.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+
+#include "hwy/contrib/math/math-inl.h"
+#include "hwy/highway.h"
+
+namespace uchen::demo {
+namespace {
+
+template <typename F>
+void ForEachLegal(std::span<const float> values, std::span<const uint64_t> mask,
+                  F f) {
+  for (size_t word = 0; word < mask.size(); ++word) {
+    for (uint64_t bits = mask[word]; bits != 0; bits &= bits - 1) {
+      size_t index = word * 64 + std::countr_zero(bits);
+      if (index >= values.size()) {
+        return;
+      }
+      f(index);
+    }
+  }
+}
+
+// Indexes of the largest values seen so far, largest first. k is expected to
+// be small so the output is kept sorted by insertion.
+class TopK {
+ public:
+  TopK(std::span<const float> values, std::span<uint32_t> output)
+      : values_(values), output_(output) {}
+
+  size_t count() const { return count_; }
+  bool full() const { return count_ == output_.size(); }
+  // Values not above the threshold are rejected once the output is full.
+  float threshold() const { return values_[output_.back()]; }
+
+  void Insert(size_t index) {
+    if (full() && values_[index] <= threshold()) {
+      return;
+    }
+    size_t position = std::min(count_, output_.size() - 1);
+    while (position > 0 && values_[output_[position - 1]] < values_[index]) {
+      output_[position] = output_[position - 1];
+      --position;
+    }
+    output_[position] = index;
+    count_ = std::min(count_ + 1, output_.size());
+  }
+
+ private:
+  std::span<const float> values_;
+  std::span<uint32_t> output_;
+  size_t count_ = 0;
+};
+
+}  // namespace
+
+HWY_BEFORE_NAMESPACE();
+namespace HWY_NAMESPACE {
+namespace {
+
+namespace hn = ::hwy::HWY_NAMESPACE;
+
+using D = hn::ScalableTag<float>;
+
+// Lanes are a power of two, at most 64 for floats.
+HWY_ATTR uint64_t LaneBits(D d) {
+  const size_t lanes = hn::Lanes(d);
+  return lanes >= 64 ? ~uint64_t{0} : (uint64_t{1} << lanes) - 1;
+}
+
+// Mask of the legal lanes starting at the lowest bit of bits.
+HWY_ATTR auto LegalLanes(D d, uint64_t bits) {
+  // LoadMaskBits reads the lanes from the lowest bit of the first byte.
+  uint8_t bytes[sizeof(bits)];
+  std::memcpy(bytes, &bits, sizeof(bits));
+  return hn::LoadMaskBits(d, bytes);
+}
+
+// Argmax over the first words * 64 values, -1 if no value is larger than
+// -infinity. Keeps the best value and its index in every lane and reduces them
+// at the end. Words without legal moves are skipped, most of them are empty.
+HWY_ATTR int32_t MaskedArgmaxHighway(const float* HWY_RESTRICT values,
+                                     const uint64_t* HWY_RESTRICT mask,
+                                     size_t words) {
+  using DI = hn::RebindToSigned<D>;
+  D d;
+  DI di;
+  const size_t lanes = hn::Lanes(d);
+  const uint64_t lane_bits = LaneBits(d);
+  auto best = hn::Set(d, -std::numeric_limits<float>::infinity());
+  auto best_index = hn::Set(di, -1);
+  const auto lane_index = hn::Iota(di, 0);
+  for (size_t word = 0; word < words; ++word) {
+    if (mask[word] == 0) {
+      continue;
+    }
+    for (size_t offset = 0; offset < 64; offset += lanes) {
+      uint64_t bits = mask[word] >> offset;
+      if ((bits & lane_bits) == 0) {
+        continue;
+      }
+      auto legal = LegalLanes(d, bits);
+      size_t base = word * 64 + offset;
+      auto v = hn::LoadU(d, values + base);
+      auto better = hn::And(legal, hn::Gt(v, best));
+      auto index = hn::Add(lane_index, hn::Set(di, static_cast<int32_t>(base)));
+      best = hn::IfThenElse(better, v, best);
+      best_index =
+          hn::IfThenElse(hn::RebindMask(di, better), index, best_index);
+    }
+  }
+  float max = hn::ReduceMax(d, best);
+  auto at_max = hn::And(hn::RebindMask(di, hn::Eq(best, hn::Set(d, max))),
+                        hn::Ge(best_index, hn::Zero(di)));
+  int32_t index = hn::ReduceMin(
+      di, hn::IfThenElse(at_max, best_index,
+                         hn::Set(di, std::numeric_limits<int32_t>::max())));
+  return index == std::numeric_limits<int32_t>::max() ? -1 : index;
+}
+
+// Offers the legal values among the first words * 64 to the top k. Once the
+// output is full only the lanes above its smallest value are offered, a vector
+// is a single compare most of the time.
+HWY_ATTR void MaskedTopKHighway(const float* HWY_RESTRICT values,
+                                const uint64_t* HWY_RESTRICT mask,
+                                size_t words, TopK& top) {
+  D d;
+  const size_t lanes = hn::Lanes(d);
+  const uint64_t lane_bits = LaneBits(d);
+  for (size_t word = 0; word < words; ++word) {
+    if (mask[word] == 0) {
+      continue;
+    }
+    for (size_t offset = 0; offset < 64; offset += lanes) {
+      uint64_t bits = mask[word] >> offset;
+      if ((bits & lane_bits) == 0) {
+        continue;
+      }
+      size_t base = word * 64 + offset;
+      if (top.full()) {
+        auto above = hn::And(LegalLanes(d, bits),
+                             hn::Gt(hn::LoadU(d, values + base),
+                                    hn::Set(d, top.threshold())));
+        if (hn::AllFalse(d, above)) {
+          continue;
+        }
+        uint8_t bytes[sizeof(bits)] = {};
+        hn::StoreMaskBits(d, above, bytes);
+        std::memcpy(&bits, bytes, sizeof(bits));
+      }
+      for (bits &= lane_bits; bits != 0; bits &= bits - 1) {
+        top.Insert(base + std::countr_zero(bits));
+      }
+    }
+  }
+}
+
+// exp((value - max) * scale) of the legal lanes, zero in the others. Values
+// of -infinity are clamped so that their exp is 0.
+HWY_ATTR auto MaskedExp(D d, hn::Mask<D> legal, hn::Vec<D> v, hn::Vec<D> max,
+                        hn::Vec<D> scale) {
+  auto x = hn::Max(hn::Mul(hn::Sub(v, max), scale),
+                   hn::Set(d, std::numeric_limits<float>::lowest()));
+  return hn::IfThenElseZero(legal, hn::Exp(d, x));
+}
+
+// Sum of exp((value - max) * scale) over the legal values among the first
+// words * 64.
+HWY_ATTR float MaskedExpSumHighway(const float* HWY_RESTRICT values,
+                                   const uint64_t* HWY_RESTRICT mask,
+                                   size_t words, float max, float scale) {
+  D d;
+  const size_t lanes = hn::Lanes(d);
+  const uint64_t lane_bits = LaneBits(d);
+  const auto max_v = hn::Set(d, max);
+  const auto scale_v = hn::Set(d, scale);
+  auto sum = hn::Zero(d);
+  for (size_t word = 0; word < words; ++word) {
+    if (mask[word] == 0) {
+      continue;
+    }
+    for (size_t offset = 0; offset < 64; offset += lanes) {
+      uint64_t bits = mask[word] >> offset;
+      if ((bits & lane_bits) == 0) {
+        continue;
+      }
+      auto v = hn::LoadU(d, values + word * 64 + offset);
+      sum = hn::Add(sum, MaskedExp(d, LegalLanes(d, bits), v, max_v, scale_v));
+    }
+  }
+  return hn::ReduceSum(d, sum);
+}
+
+// Index of the first legal value at which the running sum of
+// exp((value - max) * scale) goes above the target, -1 if it does not among
+// the first words * 64. Whole vectors are added until one crosses the target,
+// only that one is scanned lane by lane. The running sum is kept in total.
+HWY_ATTR int32_t MaskedExpSearchHighway(const float* HWY_RESTRICT values,
+                                        const uint64_t* HWY_RESTRICT mask,
+                                        size_t words, float max, float scale,
+                                        double target, double& total) {
+  D d;
+  const size_t lanes = hn::Lanes(d);
+  const uint64_t lane_bits = LaneBits(d);
+  const auto max_v = hn::Set(d, max);
+  const auto scale_v = hn::Set(d, scale);
+  HWY_ALIGN float exps[hn::MaxLanes(d)];
+  for (size_t word = 0; word < words; ++word) {
+    if (mask[word] == 0) {
+      continue;
+    }
+    for (size_t offset = 0; offset < 64; offset += lanes) {
+      uint64_t bits = mask[word] >> offset;
+      if ((bits & lane_bits) == 0) {
+        continue;
+      }
+      size_t base = word * 64 + offset;
+      auto e = MaskedExp(d, LegalLanes(d, bits),
+                         hn::LoadU(d, values + base), max_v, scale_v);
+      float sum = hn::ReduceSum(d, e);
+      if (total + sum <= target) {
+        total += sum;
+        continue;
+      }
+      hn::Store(e, d, exps);
+      for (bits &= lane_bits; bits != 0; bits &= bits - 1) {
+        size_t lane = std::countr_zero(bits);
+        total += exps[lane];
+        if (total > target) {
+          return static_cast<int32_t>(base + lane);
+        }
+      }
+    }
+  }
+  return -1;
+}
+
+}  // namespace
+}  // namespace HWY_NAMESPACE
+HWY_AFTER_NAMESPACE();
+
+std::optional<size_t> MaskedArgmax(std::span<const float> values,
+                                   std::span<const uint64_t> mask) {
+  // Vectorized over the words fully covered by the values, the rest is
+  // scalar.
+  size_t words = std::min(mask.size(), values.size() / 64);
+  int32_t vector_best =
+      HWY_STATIC_DISPATCH(MaskedArgmaxHighway)(values.data(), mask.data(),
+                                               words);
+  std::optional<size_t> best;
+  if (vector_best >= 0) {
+    best = vector_best;
+  }
+  size_t tail = words * 64;
+  ForEachLegal(values.subspan(tail), mask.subspan(words), [&](size_t index) {
+    if (!best.has_value() || values[tail + index] > values[*best]) {
+      best = tail + index;
+    }
+  });
+  if (!best.has_value()) {
+    // Every legal value is -infinity or NaN.
+    ForEachLegal(values, mask, [&](size_t index) {
+      if (!best.has_value()) {
+        best = index;
+      }
+    });
+  }
+  return best;
+}
+
+size_t MaskedTopK(std::span<const float> values,
+                  std::span<const uint64_t> mask, std::span<uint32_t> output) {
+  if (output.empty()) {
+    return 0;
+  }
+  TopK top(values, output);
+  size_t words = std::min(mask.size(), values.size() / 64);
+  HWY_STATIC_DISPATCH(MaskedTopKHighway)(values.data(), mask.data(), words,
+                                         top);
+  size_t tail = words * 64;
+  ForEachLegal(values.subspan(tail), mask.subspan(words),
+               [&](size_t index) { top.Insert(tail + index); });
+  return top.count();
+}
+
+std::optional<size_t> MaskedSoftmaxSample(std::span<const float> values,
+                                          std::span<const uint64_t> mask,
+                                          float temperature, float uniform) {
+  std::optional<size_t> best = MaskedArgmax(values, mask);
+  if (!best.has_value() || temperature <= 0) {
+    return best;
+  }
+  float max = values[*best];
+  float scale = 1 / temperature;
+  size_t words = std::min(mask.size(), values.size() / 64);
+  size_t tail = words * 64;
+  std::span<const float> tail_values = values.subspan(tail);
+  std::span<const uint64_t> tail_mask = mask.subspan(words);
+  double sum = HWY_STATIC_DISPATCH(MaskedExpSumHighway)(
+      values.data(), mask.data(), words, max, scale);
+  ForEachLegal(tail_values, tail_mask, [&](size_t index) {
+    sum += std::exp((tail_values[index] - max) * scale);
+  });
+  double target = uniform * sum;
+  double total = 0;
+  std::optional<size_t> sampled;
+  int32_t vector_sampled = HWY_STATIC_DISPATCH(MaskedExpSearchHighway)(
+      values.data(), mask.data(), words, max, scale, target, total);
+  if (vector_sampled >= 0) {
+    return vector_sampled;
+  }
+  ForEachLegal(tail_values, tail_mask, [&](size_t index) {
+    if (sampled.has_value()) {
+      return;
+    }
+    total += std::exp((tail_values[index] - max) * scale);
+    if (total > target) {
+      sampled = tail + index;
+    }
+  });
+  // Rounding may leave the target right at the sum.
+  return sampled.has_value() ? sampled : best;
+}
+
+}  // namespace uchen::demo
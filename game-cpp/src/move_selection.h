@@ -0,0 +1,42 @@
+#ifndef SRC_MOVE_SELECTION_H
+#define SRC_MOVE_SELECTION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+
+namespace uchen::demo {
+
+// Picking moves from the model output. Legal moves are a bitmask, bit i of
+// word i / 64 is set if value i may be picked. Values past the end of the mask
+// are never picked, mask bits past the end of the values must not be set.
+
+// Index of the largest legal value, nullopt if there are no legal moves. Ties
+// go to the lowest index.
+std::optional<size_t> MaskedArgmax(std::span<const float> values,
+                                   std::span<const uint64_t> mask);
+
+// Fills the output with the indexes of up to output.size() largest legal
+// values, largest first. Returns the number of indexes written.
+size_t MaskedTopK(std::span<const float> values,
+                  std::span<const uint64_t> mask, std::span<uint32_t> output);
+
+// Samples a legal index with the probability softmax(value / temperature).
+// Uniform is a random number in [0, 1). Zero temperature is the argmax.
+std::optional<size_t> MaskedSoftmaxSample(std::span<const float> values,
+                                          std::span<const uint64_t> mask,
+                                          float temperature, float uniform);
+
+template <typename Gen>
+std::optional<size_t> MaskedSoftmaxSample(std::span<const float> values,
+                                          std::span<const uint64_t> mask,
+                                          float temperature, Gen& gen) {
+  std::uniform_real_distribution<float> dis(0, 1);
+  return MaskedSoftmaxSample(values, mask, temperature, dis(gen));
+}
+
+}  // namespace uchen::demo
+
+#endif  // SRC_MOVE_SELECTION_H
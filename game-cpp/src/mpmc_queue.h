@@ -0,0 +1,109 @@
+#ifndef SRC_MPMC_QUEUE_H
+#define SRC_MPMC_QUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace uchen::demo {
+
+// Bounded queue for many producers and many consumers, without locks. Every
+// cell has a sequence number that tells whose turn it is: the producer of
+// position p waits for p, the consumer waits for p + 1. Producers and
+// consumers only contend on their own counter, a full or empty queue is
+// reported instead of waited on.
+template <typename T>
+class MpmcQueue {
+ public:
+  // Capacity is rounded up to a power of two.
+  explicit MpmcQueue(size_t capacity)
+      : mask_(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1),
+        cells_(std::make_unique<Cell[]>(mask_ + 1)) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Returns false if the queue is full. Arguments are only used on success,
+  // a value moved in is left intact otherwise.
+  template <typename... Args>
+  bool TryEmplace(Args&&... args) {
+    size_t position = enqueue_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[position & mask_];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(sequence) -
+                  static_cast<intptr_t>(position);
+      if (diff == 0) {
+        if (enqueue_.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+          cell.value.emplace(std::forward<Args>(args)...);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        // Consumer of the previous lap has not freed the cell yet.
+        return false;
+      } else {
+        position = enqueue_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  bool TryPush(T&& value) { return TryEmplace(std::move(value)); }
+
+  // Oldest value, nullopt if the queue is empty.
+  std::optional<T> TryPop() {
+    size_t position = dequeue_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[position & mask_];
+      size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(sequence) -
+                  static_cast<intptr_t>(position + 1);
+      if (diff == 0) {
+        if (dequeue_.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+          std::optional<T> result = std::move(cell.value);
+          cell.value.reset();
+          // Free for the producer of the next lap.
+          cell.sequence.store(position + mask_ + 1, std::memory_order_release);
+          return result;
+        }
+      } else if (diff < 0) {
+        return std::nullopt;
+      } else {
+        position = dequeue_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Approximate when other threads are using the queue.
+  size_t size() const {
+    size_t dequeued = dequeue_.load(std::memory_order_relaxed);
+    size_t enqueued = enqueue_.load(std::memory_order_relaxed);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+  }
+
+ private:
+  // Own cache lines, so neighbour cells do not bounce between cores.
+  struct alignas(64) Cell {
+    std::atomic<size_t> sequence{0};
+    std::optional<T> value;
+  };
+
+  size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(64) std::atomic<size_t> enqueue_{0};
+  alignas(64) std::atomic<size_t> dequeue_{0};
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_MPMC_QUEUE_H
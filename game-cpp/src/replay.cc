@@ -1,5 +1,6 @@
 #include "src/replay.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iterator>
@@ -94,26 +95,12 @@ bool WritePlayerLog(
 }
 
 void FillTensor(std::span<float> tensor, std::span<const uint32_t> input,
-                uint8_t channel) {
+                Game::Feature feature) {
   for (size_t index : input) {
-    size_t c = index % 64;
-    size_t r = index / 64;
-    tensor[((c * 64) + r) * 4 + channel] = 1.f;
+    tensor[Game::FeatureOffset(feature, index % 64, index / 64)] = 1.f;
   }
 }
 
-Game::QModel::input_t EncodeAsTensor(
-    const DotGameReplay::SelfPlayTurnRecord& record) {
-  auto store = uchen::memory::ArrayStore<
-      float, Game::QModel::input_t::elements>::NewInstance(0.f);
-  std::span span = store->data();
-  FillTensor(span, record.dots_our, 0);
-  FillTensor(span, record.dots_our, 1);
-  FillTensor(span, record.dots_our, 2);
-  FillTensor(span, record.dots_our, 3);
-  return Game::QModel::input_t{span, std::move(store)};
-}
-
 void BellmanRewards(auto begin, auto end, float gamma) {
   float reward = 0;
   for (auto it = begin; it != end; ++it) {
@@ -126,7 +113,7 @@ void UpdateReplays(std::span<const DotGameReplay::SelfPlayTurnRecord> replays,
                    auto inserter) {
   float previous_score = 0;
   for (const auto& replay : replays) {
-    auto result = std::pair(EncodeAsTensor(replay),
+    auto result = std::pair(replay,
                             learning::DeepQExpectation{.action = replay.move});
     float score = replay.score_our * 10.f - replay.score_opponent;
     result.second.bellman_target = score - previous_score;
@@ -199,6 +186,21 @@ std::optional<DotGameReplay> DotGameReplay::Load(std::istream& is) {
   return replay;
 }
 
+// static
+std::optional<std::vector<DotGameReplay>> DotGameReplay::LoadAll(
+    std::istream& is) {
+  std::vector<DotGameReplay> replays;
+  while (is.peek() != std::char_traits<char>::eof()) {
+    std::optional<DotGameReplay> replay = Load(is);
+    // Load() returns an empty replay on a bad header, the stream fails then.
+    if (!replay.has_value() || !is) {
+      return std::nullopt;
+    }
+    replays.push_back(std::move(replay).value());
+  }
+  return replays;
+}
+
 void DotGameReplay::RecordTurn(const Game& game, int step, uint32_t move,
                                uint32_t player) {
   SelfPlayTurnRecord result = {
@@ -219,6 +221,21 @@ void DotGameReplay::RecordTurn(const Game& game, int step, uint32_t move,
   replays_[player - 1].emplace_back(std::move(result));
 }
 
+std::vector<DotGameReplay::Move> DotGameReplay::Moves() const {
+  std::vector<Move> moves;
+  moves.reserve(turns());
+  for (uint32_t player = 1; player <= replays_.size(); ++player) {
+    for (const auto& record : replays_[player - 1]) {
+      moves.push_back(
+          {.step = record.step, .index = record.move, .player = player});
+    }
+  }
+  std::stable_sort(
+      moves.begin(), moves.end(),
+      [](const Move& a, const Move& b) { return a.step < b.step; });
+  return moves;
+}
+
 bool DotGameReplay::Write(std::ostream& ostream) const {
   ostream << kDotReplaysMark;
   return WritePlayerLog(ostream, replays_[0]) &&
@@ -229,6 +246,15 @@ std::vector<std::pair<Game::QModel::input_t, learning::DeepQExpectation>>
 DotGameReplay::ToTrainingSet(float gamma) const {
   std::vector<std::pair<Game::QModel::input_t, learning::DeepQExpectation>>
       result;
+  for (const auto& [record, expectation] : ToTransitions(gamma)) {
+    result.emplace_back(EncodeAsTensor(record), expectation);
+  }
+  return result;
+}
+
+std::vector<DotGameReplay::Transition> DotGameReplay::ToTransitions(
+    float gamma) const {
+  std::vector<Transition> result;
   UpdateReplays(replays_[0], std::back_inserter(result));
   size_t player1_records = result.size();
   UpdateReplays(replays_[1], std::back_inserter(result));
@@ -237,6 +263,19 @@ DotGameReplay::ToTrainingSet(float gamma) const {
   return result;
 }
 
+// static
+Game::QModel::input_t DotGameReplay::EncodeAsTensor(
+    const SelfPlayTurnRecord& record) {
+  auto store = uchen::memory::ArrayStore<
+      float, Game::QModel::input_t::elements>::NewInstance(0.f);
+  std::span span = store->data();
+  FillTensor(span, record.dots_our, Game::Feature::kOwnDots);
+  FillTensor(span, record.dots_opponent, Game::Feature::kOpponentDots);
+  FillTensor(span, record.captured_our, Game::Feature::kOwnCaptured);
+  FillTensor(span, record.captured_opponent, Game::Feature::kOpponentCaptured);
+  return Game::QModel::input_t{span, std::move(store)};
+}
+
 bool operator==(const DotGameReplay& a, const DotGameReplay& b) {
   for (size_t p = 0; p < a.replays_.size(); ++p) {
     const auto& ar = a.replays_[p];
@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <istream>
 #include <ostream>
+#include <utility>
 #include <vector>
 
 #include "absl/strings/str_join.h"
@@ -40,15 +41,36 @@ class DotGameReplay {
     }
   };
 
+  // Training sample that keeps the dots rather than the dense features, a
+  // small fraction of the size.
+  using Transition = std::pair<SelfPlayTurnRecord, learning::DeepQExpectation>;
+
+  struct Move {
+    int step;
+    uint32_t index;
+    uint32_t player;
+  };
+
   static std::optional<DotGameReplay> Load(std::istream& is);
+  // Replays written one after another until the end of the stream.
+  static std::optional<std::vector<DotGameReplay>> LoadAll(std::istream& is);
 
   void RecordTurn(const Game& game, int step, uint32_t move, uint32_t player);
   bool Write(std::ostream& ostream) const;
 
   size_t turns() const { return replays_[0].size() + replays_[1].size(); }
 
+  // Recorded moves of both players in the order they were made. The first
+  // dot placed before self-play starts is not recorded.
+  std::vector<Move> Moves() const;
+
   std::vector<std::pair<Game::QModel::input_t, learning::DeepQExpectation>>
   ToTrainingSet(float gamma) const;
+  // Same samples as ToTrainingSet(), not encoded yet.
+  std::vector<Transition> ToTransitions(float gamma) const;
+
+  // Same layout as Game::features().
+  static Game::QModel::input_t EncodeAsTensor(const SelfPlayTurnRecord& record);
 
   friend bool operator==(const DotGameReplay& a, const DotGameReplay& b);
 
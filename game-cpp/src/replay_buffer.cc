@@ -0,0 +1,91 @@
+#include "src/replay_buffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+
+namespace uchen::demo {
+
+ReplayBuffer::ReplayBuffer(size_t capacity, Options options)
+    : capacity_(capacity),
+      options_(options),
+      leaves_(std::bit_ceil(capacity)),
+      tree_(leaves_ * 2, 0) {
+  CHECK_GT(capacity_, 0);
+  transitions_.reserve(capacity_);
+}
+
+void ReplayBuffer::Add(DotGameReplay::Transition transition) {
+  size_t index = next_;
+  if (transitions_.size() < capacity_) {
+    transitions_.push_back(std::move(transition));
+  } else {
+    transitions_[index] = std::move(transition);
+  }
+  next_ = (next_ + 1) % capacity_;
+  SetPriority(index, max_priority_);
+}
+
+std::vector<size_t> ReplayBuffer::Sample(
+    std::span<const float> uniforms) const {
+  std::vector<size_t> indexes;
+  if (transitions_.empty()) {
+    return indexes;
+  }
+  indexes.reserve(uniforms.size());
+  double range = total_priority() / uniforms.size();
+  for (size_t i = 0; i < uniforms.size(); ++i) {
+    double target = (i + uniforms[i]) * range;
+    size_t node = 1;
+    while (node < leaves_) {
+      node *= 2;
+      if (target >= tree_[node]) {
+        target -= tree_[node];
+        ++node;
+      }
+    }
+    // Rounding may walk past the last transition.
+    indexes.push_back(std::min(node - leaves_, transitions_.size() - 1));
+  }
+  return indexes;
+}
+
+void ReplayBuffer::UpdatePriorities(std::span<const size_t> indexes,
+                                    std::span<const float> losses) {
+  CHECK_EQ(indexes.size(), losses.size());
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    CHECK_LT(indexes[i], transitions_.size());
+    double priority = std::pow(std::sqrt(losses[i]) + options_.epsilon,
+                               options_.alpha);
+    max_priority_ = std::max(max_priority_, priority);
+    SetPriority(indexes[i], priority);
+  }
+}
+
+std::vector<std::pair<Game::QModel::input_t, learning::DeepQExpectation>>
+ReplayBuffer::Encode(std::span<const size_t> indexes) const {
+  std::vector<std::pair<Game::QModel::input_t, learning::DeepQExpectation>>
+      result;
+  result.reserve(indexes.size());
+  for (size_t index : indexes) {
+    const auto& [record, expectation] = transitions_[index];
+    result.emplace_back(DotGameReplay::EncodeAsTensor(record), expectation);
+  }
+  return result;
+}
+
+void ReplayBuffer::SetPriority(size_t index, double priority) {
+  size_t node = leaves_ + index;
+  double delta = priority - tree_[node];
+  for (; node > 0; node /= 2) {
+    tree_[node] += delta;
+  }
+}
+
+}  // namespace uchen::demo
@@ -0,0 +1,87 @@
+#ifndef SRC_REPLAY_BUFFER_H
+#define SRC_REPLAY_BUFFER_H
+
+#include <cstddef>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "src/deepq_loss.h"
+#include "src/game.h"
+#include "src/replay.h"
+
+namespace uchen::demo {
+
+// Latest transitions up to the capacity, sampled in proportion to their
+// priority: (|TD error| + epsilon) ^ alpha. Priorities are the leaves of a sum
+// tree where every inner node holds the sum of its children, so both sampling
+// and updates take O(log n). New transitions get the highest priority seen so
+// far and are likely to be sampled before their error is known.
+class ReplayBuffer {
+ public:
+  struct Options {
+    // 0 samples uniformly, 1 fully in proportion to the error.
+    float alpha = 0.6f;
+    // Keeps transitions the model fits from never being sampled again.
+    float epsilon = 1e-3f;
+  };
+
+  explicit ReplayBuffer(size_t capacity) : ReplayBuffer(capacity, Options{}) {}
+  ReplayBuffer(size_t capacity, Options options);
+
+  size_t size() const { return transitions_.size(); }
+  size_t capacity() const { return capacity_; }
+  double total_priority() const { return tree_[1]; }
+  double priority(size_t index) const { return tree_[leaves_ + index]; }
+
+  const DotGameReplay::Transition& operator[](size_t index) const {
+    return transitions_[index];
+  }
+
+  // Replaces the oldest transition once the buffer is full.
+  void Add(DotGameReplay::Transition transition);
+
+  // Indexes of uniforms.size() transitions, drawn with replacement. Total
+  // priority is split into as many equal ranges, uniform i is a number in
+  // [0, 1) that picks a point within range i.
+  std::vector<size_t> Sample(std::span<const float> uniforms) const;
+
+  template <typename Gen>
+  std::vector<size_t> Sample(size_t batch, Gen& gen) const {
+    std::uniform_real_distribution<float> dis(0, 1);
+    std::vector<float> uniforms(batch);
+    for (float& uniform : uniforms) {
+      uniform = dis(gen);
+    }
+    return Sample(uniforms);
+  }
+
+  // DeepQLoss of every sampled transition, the squared TD error. Indexes may
+  // repeat, the last loss wins.
+  void UpdatePriorities(std::span<const size_t> indexes,
+                        std::span<const float> losses);
+
+  // Features of the transitions, in the order of the indexes.
+  std::vector<std::pair<Game::QModel::input_t, learning::DeepQExpectation>>
+  Encode(std::span<const size_t> indexes) const;
+
+ private:
+  void SetPriority(size_t index, double priority);
+
+  size_t capacity_;
+  Options options_;
+  // Leaves of the tree, a power of two no smaller than the capacity.
+  size_t leaves_;
+  // Node i has children 2i and 2i + 1, the root is 1 and the priority of
+  // transition i is at leaves_ + i.
+  std::vector<double> tree_;
+  std::vector<DotGameReplay::Transition> transitions_;
+  // Oldest transition once the buffer is full.
+  size_t next_ = 0;
+  double max_priority_ = 1;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_REPLAY_BUFFER_H
@@ -0,0 +1,115 @@
+#include "src/rollout.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <span>
+
+namespace uchen::demo {
+namespace {
+
+// Some two of the dots around a cell are already connected but not next to
+// each other, so a dot in the cell closes a loop that may capture. Same test
+// Game::FillPolygons() runs before searching for the enclosure.
+bool ClosesLoop(const Game& game, std::span<const size_t> dots) {
+  size_t width = game.width();
+  for (size_t i = 0; i < dots.size(); ++i) {
+    for (size_t j = i + 1; j < dots.size(); ++j) {
+      int dx = static_cast<int>(dots[i] % width) -
+               static_cast<int>(dots[j] % width);
+      int dy = static_cast<int>(dots[i] / width) -
+               static_cast<int>(dots[j] / width);
+      if ((std::abs(dx) > 1 || std::abs(dy) > 1) &&
+          game.Connected(dots[i], dots[j])) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+Rollout::Rollout(Options options, uint64_t seed)
+    : options_(options), gen_(seed) {
+  weights_.reserve(Game::kBufferSize);
+}
+
+Rollout::Result Rollout::Play(Game& game, uint8_t player) {
+  auto start = std::chrono::steady_clock::now();
+  Result result;
+  while (options_.max_moves == 0 || result.moves < options_.max_moves) {
+    std::optional<size_t> move = SelectMove(game, player);
+    if (!move.has_value()) {
+      break;
+    }
+    game.PlaceDot(*move, player);
+    player = 3 - player;
+    ++result.moves;
+  }
+  result.scores[0] = game.player_score(1);
+  result.scores[1] = game.player_score(2);
+  ++stats_.games;
+  stats_.moves += result.moves;
+  stats_.elapsed += std::chrono::steady_clock::now() - start;
+  return result;
+}
+
+std::optional<size_t> Rollout::SelectMove(const Game& game, uint8_t player) {
+  std::span<const uint16_t> moves = game.good_moves();
+  if (moves.empty()) {
+    return std::nullopt;
+  }
+  weights_.clear();
+  float total = 0;
+  for (uint16_t move : moves) {
+    total += Weight(game, player, move);
+    weights_.push_back(total);
+  }
+  std::uniform_real_distribution<float> dis(0, total);
+  size_t i = std::upper_bound(weights_.begin(), weights_.end(), dis(gen_)) -
+             weights_.begin();
+  // Rounding may put the sample right at the total.
+  return moves[std::min(i, moves.size() - 1)];
+}
+
+float Rollout::Weight(const Game& game, uint8_t player, size_t index) const {
+  std::span<const uint8_t> field = game.field();
+  int width = game.width();
+  int height = field.size() / width;
+  int x = index % width;
+  int y = index / width;
+  std::array<size_t, 8> own;
+  std::array<size_t, 8> opponent;
+  size_t own_count = 0;
+  size_t opponent_count = 0;
+  for (auto [dx, dy] : Game::Polygon::kDirections) {
+    int nx = x + dx;
+    int ny = y + dy;
+    if (nx < 0 || nx >= width || ny < 0 || ny >= height) {
+      continue;
+    }
+    size_t neighbor = nx + ny * width;
+    if (field[neighbor] == player) {
+      own[own_count++] = neighbor;
+    } else if (field[neighbor] != 0) {
+      opponent[opponent_count++] = neighbor;
+    }
+  }
+  float weight = 1 + own_count * options_.own_contact +
+                 opponent_count * options_.opponent_contact;
+  if (ClosesLoop(game, std::span(own).first(own_count))) {
+    weight += options_.closing;
+  }
+  if (ClosesLoop(game, std::span(opponent).first(opponent_count))) {
+    weight += options_.blocking;
+  }
+  return weight;
+}
+
+}  // namespace uchen::demo
@@ -0,0 +1,84 @@
+#ifndef SRC_ROLLOUT_H
+#define SRC_ROLLOUT_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "src/game.h"
+
+namespace uchen::demo {
+
+// Plays games out with a cheap heuristic instead of the model. Moves are
+// sampled from the good moves with weights from the dots around them: contact
+// with other dots, moves that close a loop of the player and moves that
+// block a loop of the opponent. Scratch space is allocated once and the
+// game reuses its buffers across Rollback(), so playouts from a checkpoint
+// do not allocate once the first few have warmed up. An instance should not
+// be shared between threads.
+class Rollout {
+ public:
+  struct Options {
+    // Moves to play, 0 plays until there are no good moves left.
+    size_t max_moves = 0;
+    // Added to the weight for every own and opponent dot next to the move.
+    float own_contact = 0.5f;
+    float opponent_contact = 0.5f;
+    // Added when the move joins two own dots that are not next to each other
+    // but are already connected, so it closes a loop that may capture.
+    float closing = 8.f;
+    // Same for the opponent dots, playing there keeps the loop open.
+    float blocking = 4.f;
+  };
+
+  struct Result {
+    size_t moves = 0;
+    uint32_t scores[2] = {0, 0};
+
+    // 1 for a win of the player, -1 for a loss and 0 for a draw.
+    float value(uint8_t player) const {
+      int64_t ours = scores[player - 1];
+      int64_t theirs = scores[2 - player];
+      return ours > theirs ? 1 : (ours < theirs ? -1 : 0);
+    }
+  };
+
+  struct Stats {
+    size_t games = 0;
+    size_t moves = 0;
+    std::chrono::nanoseconds elapsed{0};
+
+    double games_per_second() const {
+      return elapsed.count() == 0 ? 0 : games * 1e9 / elapsed.count();
+    }
+  };
+
+  Rollout(Options options, uint64_t seed);
+
+  // Plays from the position with the player to move first. The game is
+  // changed in place, use Game::Checkpoint() to play several rollouts from
+  // the same position.
+  Result Play(Game& game, uint8_t player);
+
+  // Heuristic move for the player, nullopt if there are no good moves.
+  std::optional<size_t> SelectMove(const Game& game, uint8_t player);
+
+  // Totals of all the rollouts played so far.
+  const Stats& stats() const { return stats_; }
+
+ private:
+  float Weight(const Game& game, uint8_t player, size_t index) const;
+
+  Options options_;
+  std::mt19937 gen_;
+  // Cumulative weights of the good moves.
+  std::vector<float> weights_;
+  Stats stats_;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_ROLLOUT_H
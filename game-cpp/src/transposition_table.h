@@ -0,0 +1,103 @@
+#ifndef SRC_TRANSPOSITION_TABLE_H
+#define SRC_TRANSPOSITION_TABLE_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "absl/log/check.h"
+
+namespace uchen::demo {
+
+// Fixed-size cache of evaluated positions keyed by Game::position_key(). Safe
+// to share between threads without locks: every slot stores the key XOR-ed
+// with the data, so a slot torn by concurrent writes fails the key check and
+// reads as a miss. Cached values are only valid for the model parameters they
+// were computed with, call Clear() when those change.
+class TranspositionTable {
+ public:
+  enum class Bound : uint8_t { kExact, kLower, kUpper };
+
+  struct Entry {
+    uint16_t move;
+    // Search depth the value was computed at, 0 for a plain model evaluation.
+    uint8_t depth;
+    Bound bound;
+    float value;
+  };
+
+  // Table has 2^bits slots, 16 bytes each.
+  explicit TranspositionTable(size_t bits)
+      : mask_(MaskFor(bits)), slots_(std::make_unique<Slot[]>(mask_ + 1)) {}
+
+  size_t size() const { return mask_ + 1; }
+
+  std::optional<Entry> Probe(uint64_t hash) const {
+    const Slot& slot = slots_[hash & mask_];
+    uint64_t data = slot.data.load(std::memory_order_relaxed);
+    uint64_t key = slot.key.load(std::memory_order_relaxed);
+    if ((key ^ data) != hash || data == 0) {
+      return std::nullopt;
+    }
+    return Unpack(data);
+  }
+
+  // Replaces the slot unless it holds the same position searched deeper.
+  void Store(uint64_t hash, const Entry& entry) {
+    Slot& slot = slots_[hash & mask_];
+    uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+    uint64_t old_key = slot.key.load(std::memory_order_relaxed);
+    if ((old_key ^ old_data) == hash && old_data != 0 &&
+        Unpack(old_data).depth > entry.depth) {
+      return;
+    }
+    uint64_t data = Pack(entry);
+    slot.key.store(hash ^ data, std::memory_order_relaxed);
+    slot.data.store(data, std::memory_order_relaxed);
+  }
+
+  void Clear() {
+    for (size_t i = 0; i <= mask_; ++i) {
+      slots_[i].key.store(0, std::memory_order_relaxed);
+      slots_[i].data.store(0, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  // Checked before anything is allocated.
+  static size_t MaskFor(size_t bits) {
+    CHECK_LT(bits, 40);
+    return (size_t{1} << bits) - 1;
+  }
+
+  struct Slot {
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> data{0};
+  };
+
+  // Layout: value bits (32) | move (16) | depth (8) | bound (6) | valid (2).
+  // The valid bits keep packed data from ever being 0, which marks empty
+  // slots.
+  static uint64_t Pack(const Entry& entry) {
+    return (uint64_t{std::bit_cast<uint32_t>(entry.value)} << 32) |
+           (uint64_t{entry.move} << 16) | (uint64_t{entry.depth} << 8) |
+           (static_cast<uint64_t>(entry.bound) << 2) | 1;
+  }
+
+  static Entry Unpack(uint64_t data) {
+    return {.move = static_cast<uint16_t>(data >> 16),
+            .depth = static_cast<uint8_t>(data >> 8),
+            .bound = static_cast<Bound>((data >> 2) & 0x3f),
+            .value = std::bit_cast<float>(static_cast<uint32_t>(data >> 32))};
+  }
+
+  size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+};
+
+}  // namespace uchen::demo
+
+#endif  // SRC_TRANSPOSITION_TABLE_H
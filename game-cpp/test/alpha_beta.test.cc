@@ -0,0 +1,76 @@
+#include "src/alpha_beta.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/game.h"
+#include "src/transposition_table.h"
+#include "test/test_positions.h"
+
+namespace uchen::demo {
+namespace {
+
+TEST(AlphaBetaTest, FindsCapture) {
+  Game game = CapturePosition();
+  AlphaBeta search(nullptr, {.max_depth = 3});
+  AlphaBeta::Stats stats;
+  EXPECT_EQ(search.Search(game, 1, nullptr, &stats), 4 * 8 + 3);
+  EXPECT_EQ(stats.depth, 3);
+  EXPECT_EQ(stats.value, 1);
+  EXPECT_GT(stats.nodes, 0);
+}
+
+TEST(AlphaBetaTest, BlocksCapture) {
+  Game game = CapturePosition();
+  TranspositionTable table(16);
+  AlphaBeta search(nullptr, {.max_depth = 2});
+  AlphaBeta::Stats stats;
+  EXPECT_EQ(search.Search(game, 2, &table, &stats), 4 * 8 + 3);
+  EXPECT_EQ(stats.value, 0);
+}
+
+TEST(AlphaBetaTest, RestoresGame) {
+  Game game = CapturePosition();
+  Game copy = game;
+  AlphaBeta search(nullptr, {.max_depth = 3, .max_width = 8});
+  ASSERT_TRUE(search.Search(game, 1).has_value());
+  EXPECT_THAT(game.field(), ::testing::ElementsAreArray(copy.field()));
+  EXPECT_EQ(game.hash(), copy.hash());
+  EXPECT_EQ(game.good_moves().size(), copy.good_moves().size());
+}
+
+TEST(AlphaBetaTest, ScorerBreaksTies) {
+  Game game(8, 8);
+  game.PlaceDot(27, 1);
+  auto scorer = [](const Game& game, uint8_t player, std::span<float> scores) {
+    scores[45] = 1;
+  };
+  AlphaBeta search(scorer, {.max_depth = 1});
+  EXPECT_EQ(search.Search(game, 2), 45);
+}
+
+TEST(AlphaBetaTest, TimeBudget) {
+  Game game = CapturePosition();
+  AlphaBeta search(nullptr, {.max_depth = 60,
+                             .time_budget = std::chrono::milliseconds(20)});
+  AlphaBeta::Stats stats;
+  std::optional<size_t> move = search.Search(game, 1, nullptr, &stats);
+  ASSERT_TRUE(move.has_value());
+  EXPECT_EQ(game.field()[*move], 0);
+  EXPECT_LT(stats.depth, 60);
+}
+
+TEST(AlphaBetaTest, NoMoves) {
+  Game game(4, 4);
+  AlphaBeta search(nullptr, {});
+  EXPECT_EQ(search.Search(game, 1), std::nullopt);
+}
+
+}  // namespace
+}  // namespace uchen::demo
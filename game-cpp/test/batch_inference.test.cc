@@ -0,0 +1,54 @@
+#include "src/batch_inference.h"
+
+#include <cstddef>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/game.h"
+
+namespace uchen::demo {
+namespace {
+
+Game::QModel::input_t RandomInput(int seed) {
+  std::mt19937 gen(seed);
+  std::bernoulli_distribution dot(0.1);
+  Game::QModel::input_t input;
+  for (float& v : input.data()) {
+    v = dot(gen) ? 1 : 0;
+  }
+  return input;
+}
+
+TEST(BatchInferenceTest, MatchesModel) {
+  ModelParameters<Game::QModel> parameters =
+      RandomParameters(&Game::model, -0.05f, 0.05f, 42);
+  std::vector<Game::QModel::input_t> inputs = {RandomInput(1), RandomInput(2),
+                                               RandomInput(3)};
+  BatchInference inference(parameters);
+  std::span<const float> outputs = inference.Evaluate(inputs);
+  ASSERT_EQ(outputs.size(), inputs.size() * BatchInference::kOutputs);
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    auto expected = Game::model(inputs[i], parameters);
+    std::vector<float> expected_values(expected.begin(), expected.end());
+    std::vector<::testing::Matcher<float>> matchers;
+    for (float v : expected_values) {
+      matchers.push_back(::testing::FloatNear(v, 1e-3f));
+    }
+    EXPECT_THAT(outputs.subspan(i * BatchInference::kOutputs,
+                                BatchInference::kOutputs),
+                ::testing::ElementsAreArray(matchers))
+        << "Input " << i;
+  }
+  // Buffers are reused for a smaller batch.
+  outputs = inference.Evaluate(std::span(inputs).subspan(2));
+  ASSERT_EQ(outputs.size(), BatchInference::kOutputs);
+  auto expected = Game::model(inputs[2], parameters);
+  EXPECT_NEAR(outputs[100], expected[100], 1e-3f);
+}
+
+}  // namespace
+}  // namespace uchen::demo
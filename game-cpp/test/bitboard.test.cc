@@ -0,0 +1,96 @@
+#include "src/bitboard.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+using uchen::demo::Bitboard;
+
+TEST(BitboardTest, SetAndReset) {
+  Bitboard board;
+  EXPECT_TRUE(board.empty());
+  board.set(0, 0);
+  board.set(63, 63);
+  board.set(5, 7);
+  EXPECT_TRUE(board.test(0, 0));
+  EXPECT_TRUE(board.test(63, 63));
+  EXPECT_TRUE(board.test(5, 7));
+  EXPECT_FALSE(board.test(7, 5));
+  EXPECT_EQ(board.count(), 3);
+  board.reset(5, 7);
+  EXPECT_FALSE(board.test(5, 7));
+  EXPECT_EQ(board.count(), 2);
+}
+
+TEST(BitboardTest, Rectangle) {
+  Bitboard rect = Bitboard::Rectangle(2, 1, 4, 3);
+  EXPECT_EQ(rect.count(), 9);
+  EXPECT_EQ(rect.row(0), 0);
+  EXPECT_EQ(rect.row(1), 0b11100);
+  EXPECT_EQ(rect.row(3), 0b11100);
+  EXPECT_EQ(rect.row(4), 0);
+  EXPECT_EQ(Bitboard::Rectangle(0, 0, 63, 63).count(), 64 * 64);
+}
+
+TEST(BitboardTest, ForEach) {
+  Bitboard board;
+  board.set(3, 2);
+  board.set(1, 2);
+  board.set(60, 0);
+  std::vector<std::pair<size_t, size_t>> cells;
+  board.ForEach([&](size_t x, size_t y) { cells.emplace_back(x, y); });
+  EXPECT_THAT(cells, ::testing::ElementsAre(std::pair(60, 0), std::pair(1, 2),
+                                            std::pair(3, 2)));
+}
+
+TEST(BitboardTest, SetOperations) {
+  Bitboard rect = Bitboard::Rectangle(0, 0, 2, 2);
+  Bitboard center;
+  center.set(1, 1);
+  EXPECT_EQ((rect - center).count(), 8);
+  EXPECT_EQ(rect & center, center);
+  EXPECT_EQ(rect | center, rect);
+}
+
+TEST(BitboardTest, FillSpans) {
+  EXPECT_EQ(Bitboard::FillSpans(0b0001000, 0b1011110), 0b0011110);
+  EXPECT_EQ(Bitboard::FillSpans(0b1000000, 0b1011110), 0b1000000);
+  EXPECT_EQ(Bitboard::FillSpans(0b0000001, 0b1011110), 0);
+  EXPECT_EQ(Bitboard::FillSpans(1, ~uint64_t{0}), ~uint64_t{0});
+  EXPECT_EQ(Bitboard::FillSpans(uint64_t{1} << 63, ~uint64_t{0}),
+            ~uint64_t{0});
+}
+
+TEST(BitboardTest, Flood) {
+  // Path from the top left corner goes down, up and down again.
+  std::vector<std::string_view> rows = {
+      ".x...",  //
+      ".x.x.",  //
+      ".x.x.",  //
+      "...xx",  //
+  };
+  Bitboard walls;
+  for (size_t y = 0; y < rows.size(); ++y) {
+    for (size_t x = 0; x < rows[y].size(); ++x) {
+      if (rows[y][x] == 'x') {
+        walls.set(x, y);
+      }
+    }
+  }
+  Bitboard open = Bitboard::Rectangle(0, 0, 4, 3) - walls;
+  Bitboard seeds;
+  seeds.set(0, 0);
+  EXPECT_EQ(Bitboard::Flood(seeds, open, 0, 3), open);
+  // Rows outside of the range are left alone.
+  EXPECT_EQ(Bitboard::Flood(seeds, open, 0, 0),
+            Bitboard::Rectangle(0, 0, 0, 0));
+  // Path is cut off above the range.
+  Bitboard end;
+  end.set(4, 2);
+  EXPECT_EQ(Bitboard::Flood(end, open, 2, 3), end);
+}
@@ -1,6 +1,11 @@
 #include "src/game.h"
 
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <span>
 #include <string_view>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -10,6 +15,7 @@
 #include "absl/log/initialize.h"
 #include "absl/log/log.h"  // IWYU pragma: keep
 
+using uchen::demo::Bitboard;
 using uchen::demo::Game;
 using Direction = Game::Polygon::Direction;
 
@@ -43,6 +49,31 @@ Game::PlayerOverlay ParseOverlay(absl::string_view field, int region_id = 2) {
   return overlay;
 }
 
+void ExpectSameState(const Game& game, const Game& expected) {
+  EXPECT_THAT(game.field(), ::testing::ElementsAreArray(expected.field()));
+  ASSERT_EQ(game.player_overlays().size(), expected.player_overlays().size());
+  for (size_t i = 0; i < game.player_overlays().size(); ++i) {
+    const auto& overlay = game.player_overlays()[i];
+    const auto& expected_overlay = expected.player_overlays()[i];
+    EXPECT_EQ(overlay, expected_overlay);
+    EXPECT_EQ(overlay.dots(), expected_overlay.dots());
+    EXPECT_EQ(overlay.captured_cells(), expected_overlay.captured_cells());
+    EXPECT_EQ(overlay.regions(), expected_overlay.regions());
+    EXPECT_EQ(game.player_score(i + 1), expected.player_score(i + 1));
+  }
+  EXPECT_THAT(game.polygons(),
+              ::testing::ElementsAreArray(expected.polygons()));
+  for (uint8_t player : {1, 2}) {
+    EXPECT_THAT(game.features(player).data(),
+                ::testing::ElementsAreArray(expected.features(player).data()));
+  }
+  std::vector<int> moves = game.GetGoodAutoplayerIndexes();
+  std::vector<int> expected_moves = expected.GetGoodAutoplayerIndexes();
+  std::sort(moves.begin(), moves.end());
+  std::sort(expected_moves.begin(), expected_moves.end());
+  EXPECT_EQ(moves, expected_moves);
+}
+
 TEST(GameTest, SettingDots) {
   Game game(3, 3);
   EXPECT_THAT(game.field(), ::testing::ElementsAre(0, 0, 0, 0, 0, 0, 0, 0, 0));
@@ -103,6 +134,32 @@ TEST(GameTest, TwoPolygons) {
   EXPECT_EQ(game.player_overlay(1), ParseOverlay("|....|.x..|xxx.|.xxx|..x.|"));
 }
 
+TEST(GameTest, PolygonUpdates) {
+  Game game = BuildGame(".1.1.", "12121", ".....");
+  game.PlaceDot(11, 1);
+  EXPECT_THAT(game.polygon_update().added, ::testing::ElementsAre(1));
+  EXPECT_THAT(game.polygons(), ::testing::ElementsAre(Game::Polygon{
+                                   .x = 1,
+                                   .y = 0,
+                                   .outline = {Direction::kSe, Direction::kSw,
+                                               Direction::kNw, Direction::kNe},
+                                   .player = 1}));
+  Game copy = game;
+  size_t checkpoint = game.Checkpoint();
+  // Second loop shares a dot with the first one and merges into it.
+  game.PlaceDot(13, 1);
+  EXPECT_THAT(game.polygon_update().added, ::testing::IsEmpty());
+  EXPECT_THAT(game.polygon_update().removed, ::testing::IsEmpty());
+  EXPECT_THAT(game.polygon_update().changed, ::testing::ElementsAre(1));
+  ASSERT_EQ(game.polygons().size(), 1);
+  EXPECT_EQ(game.polygons()[0].id, 1);
+  EXPECT_EQ(game.polygons()[0].x, 1);
+  EXPECT_EQ(game.polygons()[0].y, 0);
+  EXPECT_EQ(game.polygons()[0].outline.size(), 8);
+  game.Rollback(checkpoint);
+  ExpectSameState(game, copy);
+}
+
 TEST(GameTest, TwoPolygonsOneNotFilled) {
   Game game = BuildGame("1111", "1.11", "121.", ".1.1", "1111");
   EXPECT_EQ(game.player_overlay(1), ParseOverlay("|.x..|xxx.|xxx.|.x||", 1));
@@ -117,6 +174,260 @@ TEST(GameTest, CapturedDoNotRecapture) {
   EXPECT_EQ(game.player_overlay(2), ParseOverlay("|.....|.....|.....|"));
 }
 
+TEST(GameTest, DotConnectivity) {
+  Game::DotConnectivity connectivity(6);
+  Game::Journal journal;
+  connectivity.Join(0, 1, journal);
+  connectivity.Join(3, 4, journal);
+  EXPECT_EQ(connectivity.Find(0), connectivity.Find(1));
+  EXPECT_NE(connectivity.Find(1), connectivity.Find(3));
+  EXPECT_EQ(connectivity.Find(5), 5);
+  size_t checkpoint = journal.Open();
+  connectivity.Join(4, 1, journal);
+  EXPECT_EQ(connectivity.Find(0), connectivity.Find(3));
+  EXPECT_NE(connectivity.Find(0), connectivity.Find(5));
+  for (const auto& entry : journal.Since(checkpoint)) {
+    connectivity.Undo(entry);
+  }
+  journal.Close(checkpoint);
+  EXPECT_EQ(connectivity.Find(0), connectivity.Find(1));
+  EXPECT_NE(connectivity.Find(1), connectivity.Find(3));
+}
+
+TEST(GameTest, LoopClosedBetweenConnectedNeighbors) {
+  Game game = BuildGame("..1..", ".1.1.", "1.2.1", ".1.1.", ".....");
+  EXPECT_EQ(game.player_score(1), 0);
+  // Neighbors of this dot are only connected around the opponent's dot.
+  game.PlaceDot(22, 1);
+  EXPECT_EQ(game.player_score(1), 1);
+}
+
+TEST(GameTest, RollbackCapture) {
+  Game game = BuildGame(".1...", "1.1..", ".....", ".....");
+  Game copy = game;
+  size_t checkpoint = game.Checkpoint();
+  game.PlaceDot(6, 2);
+  game.PlaceDot(11, 1);
+  game.PlaceDot(8, 2);
+  EXPECT_EQ(game.player_score(1), 1);
+  game.Rollback(checkpoint);
+  ExpectSameState(game, copy);
+  // Connectivity and region ids were restored too.
+  game.PlaceDot(6, 2);
+  game.PlaceDot(11, 1);
+  copy.PlaceDot(6, 2);
+  copy.PlaceDot(11, 1);
+  ExpectSameState(game, copy);
+}
+
+TEST(GameTest, RollbackNested) {
+  Game game(8, 8);
+  std::mt19937 gen(7);
+  std::vector<size_t> moves(64);
+  std::iota(moves.begin(), moves.end(), 0);
+  std::shuffle(moves.begin(), moves.end(), gen);
+  for (size_t i = 0; i < 20; ++i) {
+    game.PlaceDot(moves[i], i % 2 + 1);
+  }
+  Game outer_copy = game;
+  size_t outer = game.Checkpoint();
+  for (size_t i = 20; i < 40; ++i) {
+    game.PlaceDot(moves[i], i % 2 + 1);
+  }
+  Game inner_copy = game;
+  size_t inner = game.Checkpoint();
+  for (size_t i = 40; i < moves.size(); ++i) {
+    game.PlaceDot(moves[i], i % 2 + 1);
+  }
+  game.Rollback(inner);
+  ExpectSameState(game, inner_copy);
+  game.Rollback(outer);
+  ExpectSameState(game, outer_copy);
+}
+
+TEST(GameTest, HashIgnoresMoveOrder) {
+  Game a(5, 5), b(5, 5);
+  EXPECT_EQ(a.hash(), b.hash());
+  a.PlaceDot(6, 1);
+  a.PlaceDot(8, 2);
+  b.PlaceDot(8, 2);
+  EXPECT_NE(a.hash(), b.hash());
+  b.PlaceDot(6, 1);
+  EXPECT_EQ(a.hash(), b.hash());
+  // Same dots, different owners.
+  Game c(5, 5);
+  c.PlaceDot(6, 2);
+  c.PlaceDot(8, 1);
+  EXPECT_NE(a.hash(), c.hash());
+}
+
+TEST(GameTest, PositionKeyIncludesPlayer) {
+  Game game(5, 5);
+  game.PlaceDot(6, 1);
+  EXPECT_EQ(game.position_key(1), game.hash());
+  EXPECT_NE(game.position_key(2), game.position_key(1));
+}
+
+TEST(GameTest, Connected) {
+  Game game(5, 5);
+  game.PlaceDot(0, 1);
+  game.PlaceDot(2, 1);
+  game.PlaceDot(4, 2);
+  EXPECT_FALSE(game.Connected(0, 2));
+  game.PlaceDot(6, 1);
+  EXPECT_TRUE(game.Connected(0, 2));
+  EXPECT_FALSE(game.Connected(2, 4));
+}
+
+TEST(GameTest, HashIncludesCaptures) {
+  Game captured = BuildGame(".1...", "1.1..", ".....", ".....");
+  uint64_t empty = captured.hash();
+  Game uncaptured = captured;
+  captured.PlaceDot(6, 2);
+  captured.PlaceDot(11, 1);
+  EXPECT_EQ(captured.player_score(1), 1);
+  // Dot placed into an already closed loop is not captured.
+  uncaptured.PlaceDot(11, 1);
+  uncaptured.PlaceDot(6, 2);
+  EXPECT_EQ(uncaptured.player_score(1), 0);
+  EXPECT_NE(captured.hash(), uncaptured.hash());
+  EXPECT_NE(captured.hash(), empty);
+  uint64_t hash = captured.hash();
+  size_t checkpoint = captured.Checkpoint();
+  captured.PlaceDot(12, 2);
+  EXPECT_NE(captured.hash(), hash);
+  captured.Rollback(checkpoint);
+  EXPECT_EQ(captured.hash(), hash);
+}
+
+TEST(GameTest, Features) {
+  using Feature = Game::Feature;
+  Game game = BuildGame(".1...", "1.1..", ".....", ".....");
+  game.PlaceDot(6, 2);
+  game.PlaceDot(11, 1);
+  auto features = [&](uint8_t player, Feature feature) {
+    std::vector<std::pair<size_t, size_t>> cells;
+    auto data = game.features(player).data();
+    for (size_t y = 0; y < 4; ++y) {
+      for (size_t x = 0; x < 5; ++x) {
+        if (data[Game::FeatureOffset(feature, x, y)] != 0) {
+          cells.emplace_back(x, y);
+        }
+      }
+    }
+    return cells;
+  };
+  using ::testing::ElementsAre;
+  using ::testing::IsEmpty;
+  using ::testing::Pair;
+  auto dots1 = ElementsAre(Pair(1, 0), Pair(0, 1), Pair(2, 1), Pair(1, 2));
+  EXPECT_THAT(features(1, Feature::kOwnDots), dots1);
+  EXPECT_THAT(features(2, Feature::kOpponentDots), dots1);
+  EXPECT_THAT(features(2, Feature::kOwnDots), ElementsAre(Pair(1, 1)));
+  EXPECT_THAT(features(1, Feature::kOpponentDots), ElementsAre(Pair(1, 1)));
+  EXPECT_THAT(features(1, Feature::kOwnCaptured), ElementsAre(Pair(1, 1)));
+  EXPECT_THAT(features(2, Feature::kOpponentCaptured),
+              ElementsAre(Pair(1, 1)));
+  EXPECT_THAT(features(2, Feature::kOwnCaptured), IsEmpty());
+  EXPECT_THAT(features(1, Feature::kOpponentCaptured), IsEmpty());
+}
+
+TEST(GameTest, MergedRegions) {
+  Game game(8, 8);
+  game.PlaceDot(9, 2);
+  game.PlaceDot(13, 2);
+  game.PlaceDot(42, 2);
+  auto enclosure = [](size_t left, size_t top, size_t right, size_t bottom) {
+    Bitboard box = Bitboard::Rectangle(left, top, right, bottom);
+    return Game::Enclosure{
+        .bounding_box = box,
+        .enclosed = box,
+        .interior =
+            Bitboard::Rectangle(left + 1, top + 1, right - 1, bottom - 1)};
+  };
+  const Bitboard& opponent_dots = game.player_overlay(2).dots();
+  Game::PlayerOverlay overlay(8, 8, 1);
+  Game::Journal journal;
+  size_t outer = journal.Open();
+  overlay.MarkRegion(enclosure(0, 0, 2, 2), opponent_dots, journal);
+  overlay.MarkRegion(enclosure(4, 0, 6, 2), opponent_dots, journal);
+  EXPECT_EQ(overlay.get_dot(0), 1);
+  EXPECT_EQ(overlay.get_dot(6), 2);
+  size_t inner = journal.Open();
+  // Overlaps both regions, their cells outside of it join the new one too.
+  overlay.MarkRegion(enclosure(1, 1, 5, 6), opponent_dots, journal);
+  EXPECT_EQ(overlay.get_dot(0), 3);
+  EXPECT_EQ(overlay.get_dot(6), 3);
+  EXPECT_EQ(overlay.get_dot(43), 3);
+  Game::PlayerOverlay merged = overlay;
+  overlay.FlattenRegions(journal);
+  EXPECT_EQ(overlay, merged);
+  std::span<const Game::Journal::Entry> entries = journal.Since(inner);
+  for (auto it = entries.rbegin(); it != entries.rend(); ++it) {
+    overlay.Undo(*it);
+  }
+  journal.Close(inner);
+  EXPECT_EQ(overlay.get_dot(0), 1);
+  EXPECT_EQ(overlay.get_dot(6), 2);
+  EXPECT_EQ(overlay.get_dot(43), 0);
+  journal.Close(outer);
+}
+
+TEST(GameTest, CandidateSet) {
+  Game::CandidateSet set(10);
+  set.Add(3);
+  set.Add(7);
+  set.Add(5);
+  EXPECT_THAT(set.items(), ::testing::ElementsAre(3, 7, 5));
+  set.Remove(3);
+  EXPECT_THAT(set.items(), ::testing::ElementsAre(5, 7));
+  EXPECT_FALSE(set.contains(3));
+  EXPECT_TRUE(set.contains(5));
+  set.Remove(7);
+  set.Remove(5);
+  EXPECT_TRUE(set.empty());
+  set.Add(3);
+  EXPECT_THAT(set.items(), ::testing::ElementsAre(3));
+}
+
+TEST(GameTest, GoodMoves) {
+  Game game(8, 8);
+  std::mt19937 gen(3);
+  EXPECT_EQ(game.SampleGoodMove(gen), std::nullopt);
+  game.PlaceDot(0, 1);
+  std::vector<uint16_t> moves(game.good_moves().begin(),
+                              game.good_moves().end());
+  std::sort(moves.begin(), moves.end());
+  // Within 2 cells of the dot.
+  EXPECT_THAT(moves, ::testing::ElementsAre(1, 2, 8, 9, 10, 16, 17, 18));
+  game.PlaceDot(9, 2);
+  EXPECT_EQ(game.good_moves().size(), 14);
+  for (int i = 0; i < 20; ++i) {
+    std::optional<size_t> move = game.SampleGoodMove(gen);
+    ASSERT_TRUE(move.has_value());
+    EXPECT_EQ(game.field()[*move], 0);
+    EXPECT_NE(std::find(game.good_moves().begin(), game.good_moves().end(),
+                        *move),
+              game.good_moves().end());
+  }
+}
+
+TEST(GameTest, SmallBoard) {
+  uchen::demo::BasicGame<16, 16> game;
+  EXPECT_EQ(game.width(), 16);
+  EXPECT_EQ(game.field().size(), 256);
+  // Opponent dot surrounded near the bottom right corner.
+  game.PlaceDot(237, 2);
+  for (size_t index : {238, 253, 236, 221}) {
+    game.PlaceDot(index, 1);
+  }
+  EXPECT_EQ(game.player_score(1), 1);
+  EXPECT_EQ(game.polygons().size(), 1);
+  EXPECT_NE(game.features(1).data()[decltype(game)::FeatureOffset(
+                Game::Feature::kOwnCaptured, 237 % 16, 237 / 16)],
+            0);
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   absl::InitializeLog();
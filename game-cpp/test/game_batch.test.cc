@@ -0,0 +1,76 @@
+#include "src/game_batch.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/game.h"
+#include "src/transposition_table.h"
+
+namespace uchen::demo {
+namespace {
+
+TEST(GameBatchTest, GamesDoNotDependOnBatch) {
+  GameBatch batch(3, 8, 8, 5);
+  GameBatch single(1, 8, 8, 6);
+  for (int step = 0; step < 10; ++step) {
+    std::span<const uint32_t> moves = batch.Step({}, 0);
+    EXPECT_EQ(moves[1], single.Step({}, 0)[0]);
+  }
+  EXPECT_THAT(batch.game(1).field(),
+              ::testing::ElementsAreArray(single.game(0).field()));
+}
+
+TEST(GameBatchTest, UsesQValues) {
+  GameBatch batch(2, 8, 8, 1);
+  ASSERT_EQ(batch.Inputs().size(), 2);
+  std::vector<float> q_values(2 * GameBatch::kOutputs, 0);
+  // Next to the first dot at (3, 3).
+  EXPECT_EQ(batch.game(0).field()[3 * 8 + 3], 1);
+  q_values[2 * 8 + 2] = 1;
+  q_values[GameBatch::kOutputs + 4 * 8 + 4] = 1;
+  std::span<const uint32_t> moves = batch.Step(q_values, 1);
+  EXPECT_THAT(moves, ::testing::ElementsAre(2 * 8 + 2, 4 * 8 + 4));
+  EXPECT_EQ(batch.game(0).field()[2 * 8 + 2], 2);
+  EXPECT_EQ(batch.player(0), 1);
+}
+
+TEST(GameBatchTest, ReusesTableMoves) {
+  TranspositionTable table(12);
+  GameBatch first(2, 8, 8, 7, &table);
+  GameBatch second(2, 8, 8, 7, &table);
+  std::vector<float> q_values;
+  for (int step = 0; step < 10; ++step) {
+    std::span<const Game::QModel::input_t> inputs = first.Inputs();
+    ASSERT_EQ(inputs.size(), 2);
+    // Model plays the good move with the highest index.
+    q_values.resize(inputs.size() * GameBatch::kOutputs);
+    for (size_t i = 0; i < q_values.size(); ++i) {
+      q_values[i] = i % GameBatch::kOutputs;
+    }
+    std::span<const uint32_t> moves = first.Step(q_values, 1);
+    // Same games, every position was evaluated by the first batch.
+    EXPECT_THAT(second.Inputs(), ::testing::IsEmpty());
+    EXPECT_THAT(second.Step({}, 1), ::testing::ElementsAreArray(moves));
+  }
+}
+
+TEST(GameBatchTest, PlaysToCompletion) {
+  GameBatch batch(4, 4, 4, 3);
+  for (int step = 0; step < 16 && batch.active() > 0; ++step) {
+    batch.Step({}, 0);
+  }
+  EXPECT_EQ(batch.active(), 0);
+  EXPECT_THAT(batch.Step({}, 0), ::testing::Each(GameBatch::kNoMove));
+  for (size_t i = 0; i < batch.size(); ++i) {
+    EXPECT_THAT(batch.game(i).good_moves(), ::testing::IsEmpty());
+  }
+}
+
+}  // namespace
+}  // namespace uchen::demo
@@ -0,0 +1,73 @@
+#include "src/mcts.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include <gtest/gtest.h>
+
+#include "src/game.h"
+#include "test/test_positions.h"
+
+namespace uchen::demo {
+namespace {
+
+// Uniform priors, value is the score difference.
+float ScoreEvaluator(const Game& game, uint8_t player,
+                     std::span<const uint16_t> moves,
+                     std::span<float> priors) {
+  for (float& prior : priors) {
+    prior = 1.f / moves.size();
+  }
+  return std::tanh(static_cast<float>(game.player_score(player)) -
+                   game.player_score(3 - player));
+}
+
+TEST(MctsTest, FindsCapture) {
+  Mcts mcts(ScoreEvaluator, {.max_visits = 2000, .max_nodes = 1 << 18});
+  Mcts::Stats stats;
+  std::optional<size_t> move = mcts.Search(CapturePosition(), 1, &stats);
+  EXPECT_EQ(move, 4 * 8 + 3);
+  EXPECT_EQ(stats.visits, 2000);
+  EXPECT_GT(stats.nodes, 1);
+}
+
+TEST(MctsTest, FindsCaptureWithThreads) {
+  Mcts mcts(ScoreEvaluator,
+            {.threads = 4, .max_visits = 2000, .max_nodes = 1 << 18});
+  Mcts::Stats stats;
+  std::optional<size_t> move = mcts.Search(CapturePosition(), 1, &stats);
+  EXPECT_EQ(move, 4 * 8 + 3);
+  EXPECT_EQ(stats.visits, 2000);
+}
+
+TEST(MctsTest, StopsWhenNodePoolIsExhausted) {
+  Game game = CapturePosition();
+  size_t evaluations = 0;
+  Mcts mcts(
+      [&](const Game& game, uint8_t player, std::span<const uint16_t> moves,
+          std::span<float> priors) {
+        ++evaluations;
+        return ScoreEvaluator(game, player, moves, priors);
+      },
+      {.max_visits = 500, .max_nodes = 5000});
+  Mcts::Stats stats;
+  std::optional<size_t> move = mcts.Search(game, 1, &stats);
+  ASSERT_TRUE(move.has_value());
+  EXPECT_EQ(game.field()[*move], 0);
+  EXPECT_LE(stats.nodes, 5000);
+  // Every evaluation but the last one grew the tree.
+  EXPECT_LT(stats.visits, 500);
+  EXPECT_EQ(evaluations, stats.visits);
+}
+
+TEST(MctsTest, NoMoves) {
+  Game game(4, 4);
+  Mcts mcts(ScoreEvaluator, {.max_visits = 10, .max_nodes = 1 << 16});
+  EXPECT_EQ(mcts.Search(game, 1), std::nullopt);
+}
+
+}  // namespace
+}  // namespace uchen::demo
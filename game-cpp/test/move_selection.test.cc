@@ -0,0 +1,161 @@
+#include "src/move_selection.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace uchen::demo {
+namespace {
+
+std::vector<uint64_t> Mask(size_t size, std::initializer_list<size_t> legal) {
+  std::vector<uint64_t> mask((size + 63) / 64, 0);
+  for (size_t i : legal) {
+    mask[i / 64] |= uint64_t{1} << (i % 64);
+  }
+  return mask;
+}
+
+TEST(MoveSelectionTest, ArgmaxIgnoresIllegalMoves) {
+  std::vector<float> values(4096);
+  std::iota(values.begin(), values.end(), 0.f);
+  EXPECT_EQ(MaskedArgmax(values, Mask(4096, {3, 100, 2000, 70})), 2000);
+  EXPECT_EQ(MaskedArgmax(values, Mask(4096, {})), std::nullopt);
+}
+
+TEST(MoveSelectionTest, ArgmaxMatchesScalar) {
+  std::mt19937 gen(5);
+  std::normal_distribution<float> value;
+  std::bernoulli_distribution legal(0.05);
+  // Sizes that are not a multiple of 64 end in a partial word.
+  for (size_t size : {4096, 100, 7}) {
+    std::vector<float> values(size);
+    std::vector<uint64_t> mask((size + 63) / 64, 0);
+    std::optional<size_t> expected;
+    for (size_t i = 0; i < size; ++i) {
+      values[i] = value(gen);
+      if (legal(gen) || i == size / 2) {
+        mask[i / 64] |= uint64_t{1} << (i % 64);
+        if (!expected.has_value() || values[i] > values[*expected]) {
+          expected = i;
+        }
+      }
+    }
+    EXPECT_EQ(MaskedArgmax(values, mask), expected) << size;
+  }
+}
+
+TEST(MoveSelectionTest, ArgmaxTiesGoToLowestIndex) {
+  std::vector<float> values(256, 1.f);
+  EXPECT_EQ(MaskedArgmax(values, Mask(256, {200, 17, 130})), 17);
+  values.assign(256, -std::numeric_limits<float>::infinity());
+  EXPECT_EQ(MaskedArgmax(values, Mask(256, {200, 130})), 130);
+}
+
+TEST(MoveSelectionTest, TopK) {
+  std::vector<float> values = {5, 1, 9, 3, 7, 2};
+  std::vector<uint32_t> output(3);
+  EXPECT_EQ(MaskedTopK(values, Mask(6, {0, 1, 2, 3, 5}), output), 3);
+  EXPECT_THAT(output, ::testing::ElementsAre(2, 0, 3));
+  EXPECT_EQ(MaskedTopK(values, Mask(6, {1, 4}), output), 2);
+  EXPECT_THAT(std::span(output).first(2), ::testing::ElementsAre(4, 1));
+}
+
+TEST(MoveSelectionTest, TopKMatchesScalar) {
+  std::mt19937 gen(7);
+  std::normal_distribution<float> value;
+  std::bernoulli_distribution legal(0.05);
+  for (size_t size : {4096, 100, 7}) {
+    std::vector<float> values(size);
+    std::vector<uint64_t> mask((size + 63) / 64, 0);
+    std::vector<uint32_t> expected;
+    for (size_t i = 0; i < size; ++i) {
+      values[i] = value(gen);
+      if (legal(gen) || i == size / 2) {
+        mask[i / 64] |= uint64_t{1} << (i % 64);
+        expected.push_back(i);
+      }
+    }
+    std::stable_sort(expected.begin(), expected.end(),
+                     [&](uint32_t a, uint32_t b) {
+                       return values[a] > values[b];
+                     });
+    expected.resize(std::min<size_t>(expected.size(), 8));
+    std::vector<uint32_t> output(8);
+    output.resize(MaskedTopK(values, mask, output));
+    EXPECT_EQ(output, expected) << size;
+  }
+}
+
+TEST(MoveSelectionTest, SoftmaxSample) {
+  std::vector<float> values = {0, 0, 10, std::log(3.f)};
+  std::vector<uint64_t> mask = Mask(4, {0, 3});
+  // Probabilities are 1/4 and 3/4.
+  EXPECT_EQ(MaskedSoftmaxSample(values, mask, 1, 0.2f), 0);
+  EXPECT_EQ(MaskedSoftmaxSample(values, mask, 1, 0.3f), 3);
+  EXPECT_EQ(MaskedSoftmaxSample(values, mask, 0, 0.f), 3);
+  std::mt19937 gen(1);
+  int sampled = 0;
+  for (int i = 0; i < 1000; ++i) {
+    sampled += MaskedSoftmaxSample(values, mask, 1, gen) == 3;
+  }
+  EXPECT_NEAR(sampled, 750, 60);
+}
+
+TEST(MoveSelectionTest, SoftmaxSampleMatchesScalar) {
+  std::mt19937 gen(3);
+  std::normal_distribution<float> value;
+  std::bernoulli_distribution legal(0.1);
+  std::uniform_real_distribution<float> uniform(0, 1);
+  for (size_t size : {4096, 100}) {
+    std::vector<float> values(size);
+    std::vector<uint64_t> mask((size + 63) / 64, 0);
+    std::vector<size_t> legal_moves;
+    for (size_t i = 0; i < size; ++i) {
+      values[i] = value(gen);
+      if (legal(gen) || i == size / 2) {
+        mask[i / 64] |= uint64_t{1} << (i % 64);
+        legal_moves.push_back(i);
+      }
+    }
+    // Illegal values never contribute, even when they are the largest.
+    values[1] = 100;
+    double sum = 0;
+    for (size_t i : legal_moves) {
+      sum += std::exp(values[i] / 2);
+    }
+    for (int i = 0; i < 100; ++i) {
+      float u = uniform(gen);
+      double total = 0;
+      size_t expected = legal_moves.back();
+      for (size_t move : legal_moves) {
+        total += std::exp(values[move] / 2);
+        if (total > u * sum) {
+          expected = move;
+          break;
+        }
+      }
+      std::optional<size_t> sampled = MaskedSoftmaxSample(values, mask, 2, u);
+      ASSERT_TRUE(sampled.has_value());
+      // Rounding may only move the sample to a neighbouring legal move.
+      auto it = std::find(legal_moves.begin(), legal_moves.end(), expected);
+      auto sampled_it =
+          std::find(legal_moves.begin(), legal_moves.end(), *sampled);
+      ASSERT_NE(sampled_it, legal_moves.end());
+      EXPECT_LE(std::abs(sampled_it - it), 1) << size << " " << u;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace uchen::demo
@@ -0,0 +1,81 @@
+#include "src/mpmc_queue.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using uchen::demo::MpmcQueue;
+
+TEST(MpmcQueueTest, FirstInFirstOut) {
+  MpmcQueue<int> queue(3);
+  EXPECT_EQ(queue.capacity(), 4);
+  EXPECT_FALSE(queue.TryPop().has_value());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.TryPush(int{i}));
+  }
+  EXPECT_FALSE(queue.TryPush(4));
+  EXPECT_EQ(queue.size(), 4);
+  EXPECT_EQ(queue.TryPop(), 0);
+  EXPECT_EQ(queue.TryPop(), 1);
+  // Wraps around.
+  EXPECT_TRUE(queue.TryPush(4));
+  EXPECT_TRUE(queue.TryPush(5));
+  for (int i = 2; i < 6; ++i) {
+    EXPECT_EQ(queue.TryPop(), i);
+  }
+  EXPECT_FALSE(queue.TryPop().has_value());
+}
+
+TEST(MpmcQueueTest, FullQueueKeepsValue) {
+  MpmcQueue<std::unique_ptr<int>> queue(2);
+  EXPECT_TRUE(queue.TryPush(std::make_unique<int>(1)));
+  EXPECT_TRUE(queue.TryPush(std::make_unique<int>(2)));
+  auto value = std::make_unique<int>(3);
+  EXPECT_FALSE(queue.TryPush(std::move(value)));
+  ASSERT_NE(value, nullptr);
+  EXPECT_EQ(*value, 3);
+  EXPECT_EQ(**queue.TryPop(), 1);
+  EXPECT_TRUE(queue.TryPush(std::move(value)));
+  EXPECT_EQ(**queue.TryPop(), 2);
+  EXPECT_EQ(**queue.TryPop(), 3);
+}
+
+TEST(MpmcQueueTest, ManyProducersAndConsumers) {
+  constexpr size_t kThreads = 4;
+  constexpr uint64_t kValues = 10000;
+  MpmcQueue<uint64_t> queue(64);
+  std::atomic<uint64_t> sum = 0;
+  std::atomic<uint64_t> popped = 0;
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t]() {
+      for (uint64_t i = t; i < kValues; i += kThreads) {
+        while (!queue.TryPush(uint64_t{i})) {
+          std::this_thread::yield();
+        }
+      }
+    });
+    threads.emplace_back([&]() {
+      while (popped.load() < kValues) {
+        if (std::optional<uint64_t> value = queue.TryPop()) {
+          sum += *value;
+          ++popped;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(popped.load(), kValues);
+  EXPECT_EQ(sum.load(), kValues * (kValues - 1) / 2);
+  EXPECT_FALSE(queue.TryPop().has_value());
+}
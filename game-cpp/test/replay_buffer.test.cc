@@ -0,0 +1,91 @@
+#include "src/replay_buffer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/deepq_loss.h"
+#include "src/game.h"
+#include "src/replay.h"
+
+namespace uchen::demo {
+namespace {
+
+using ::testing::ElementsAre;
+
+DotGameReplay::Transition MakeTransition(uint32_t move) {
+  DotGameReplay::SelfPlayTurnRecord record;
+  record.move = move;
+  record.dots_our = {move};
+  return {record,
+          learning::DeepQExpectation{.action = move, .bellman_target = 1}};
+}
+
+TEST(ReplayBufferTest, ReplacesOldest) {
+  ReplayBuffer buffer(3);
+  for (uint32_t move = 0; move < 5; ++move) {
+    buffer.Add(MakeTransition(move));
+  }
+  EXPECT_EQ(buffer.size(), 3);
+  EXPECT_EQ(buffer[0].first.move, 3);
+  EXPECT_EQ(buffer[1].first.move, 4);
+  EXPECT_EQ(buffer[2].first.move, 2);
+  // New transitions all get the same priority.
+  EXPECT_DOUBLE_EQ(buffer.total_priority(), 3);
+}
+
+TEST(ReplayBufferTest, SamplesByPriority) {
+  ReplayBuffer buffer(4, {.alpha = 1, .epsilon = 0});
+  for (uint32_t move = 0; move < 4; ++move) {
+    buffer.Add(MakeTransition(move));
+  }
+  std::vector<size_t> indexes = {0, 1, 2, 3};
+  // Squared errors, priorities are 1, 0, 3 and 0.
+  std::vector<float> losses = {1, 0, 9, 0};
+  buffer.UpdatePriorities(indexes, losses);
+  EXPECT_DOUBLE_EQ(buffer.total_priority(), 4);
+  EXPECT_DOUBLE_EQ(buffer.priority(2), 3);
+  // One draw from every quarter of the total.
+  EXPECT_THAT(buffer.Sample(std::vector<float>{0.5f, 0.5f, 0.5f, 0.5f}),
+              ElementsAre(0, 2, 2, 2));
+  std::mt19937 gen(1);
+  std::map<size_t, size_t> counts;
+  for (size_t index : buffer.Sample(4000, gen)) {
+    ++counts[index];
+  }
+  EXPECT_EQ(counts.count(1), 0);
+  EXPECT_EQ(counts.count(3), 0);
+  EXPECT_NEAR(counts[2] / 4000.0, 0.75, 0.01);
+}
+
+TEST(ReplayBufferTest, NewTransitionsGetMaxPriority) {
+  ReplayBuffer buffer(4, {.alpha = 1, .epsilon = 0});
+  buffer.Add(MakeTransition(0));
+  std::vector<size_t> indexes = {0};
+  std::vector<float> losses = {16};
+  buffer.UpdatePriorities(indexes, losses);
+  buffer.Add(MakeTransition(1));
+  EXPECT_DOUBLE_EQ(buffer.priority(1), 4);
+}
+
+TEST(ReplayBufferTest, Encode) {
+  ReplayBuffer buffer(2);
+  buffer.Add(MakeTransition(5));
+  buffer.Add(MakeTransition(70));
+  std::vector<size_t> indexes = {1, 0};
+  auto samples = buffer.Encode(indexes);
+  ASSERT_EQ(samples.size(), 2);
+  EXPECT_EQ(samples[0].second.action, 70);
+  EXPECT_EQ(samples[1].second.action, 5);
+  EXPECT_EQ(samples[0].first.data()[Game::FeatureOffset(
+                Game::Feature::kOwnDots, 70 % 64, 70 / 64)],
+            1);
+}
+
+}  // namespace
+}  // namespace uchen::demo
@@ -0,0 +1,135 @@
+#include "src/rollout.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <optional>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/game.h"
+#include "test/test_positions.h"
+
+namespace {
+
+// Counts the calls to the global operator new in this binary.
+size_t allocations = 0;
+
+}  // namespace
+
+// Not inlined so the compiler does not pair malloc() and free() with the
+// operators.
+[[gnu::noinline]] void* operator new(size_t size) {
+  ++allocations;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    std::abort();
+  }
+  return p;
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t /* size */) noexcept {
+  std::free(p);
+}
+
+namespace uchen::demo {
+namespace {
+
+TEST(RolloutTest, PlaysToCompletion) {
+  Game game(6, 6);
+  game.PlaceDot(3 * 6 + 3, 1);
+  Rollout rollout({}, 1);
+  Rollout::Result result = rollout.Play(game, 2);
+  EXPECT_THAT(game.good_moves(), ::testing::IsEmpty());
+  EXPECT_EQ(result.moves, 35);
+  EXPECT_EQ(result.scores[0], game.player_score(1));
+  EXPECT_EQ(result.scores[1], game.player_score(2));
+  EXPECT_EQ(rollout.stats().games, 1);
+  EXPECT_EQ(rollout.stats().moves, 35);
+}
+
+TEST(RolloutTest, StopsAtMaxMoves) {
+  Game game = CapturePosition();
+  Game copy = game;
+  Rollout rollout({.max_moves = 5}, 2);
+  size_t checkpoint = game.Checkpoint();
+  EXPECT_EQ(rollout.Play(game, 1).moves, 5);
+  EXPECT_EQ(std::count(game.field().begin(), game.field().end(), 0),
+            std::count(copy.field().begin(), copy.field().end(), 0) - 5);
+  game.Rollback(checkpoint);
+  EXPECT_THAT(game.field(), ::testing::ElementsAreArray(copy.field()));
+}
+
+TEST(RolloutTest, PrefersClosingMoves) {
+  Game game = CapturePosition();
+  Rollout rollout({}, 3);
+  std::map<size_t, int> counts;
+  for (int i = 0; i < 1000; ++i) {
+    std::optional<size_t> move = rollout.SelectMove(game, 1);
+    ASSERT_TRUE(move.has_value());
+    ++counts[*move];
+  }
+  auto most_common = std::max_element(
+      counts.begin(), counts.end(),
+      [](const auto& a, const auto& b) { return a.second < b.second; });
+  EXPECT_EQ(most_common->first, 4 * 8 + 3);
+}
+
+TEST(RolloutTest, IgnoresUnconnectedDots) {
+  Game game(8, 8);
+  game.PlaceDot(3 * 8 + 2, 1);
+  game.PlaceDot(7 * 8 + 7, 2);
+  game.PlaceDot(3 * 8 + 4, 1);
+  ASSERT_FALSE(game.Connected(3 * 8 + 2, 3 * 8 + 4));
+  Rollout rollout({}, 3);
+  std::map<size_t, int> counts;
+  for (int i = 0; i < 1000; ++i) {
+    std::optional<size_t> move = rollout.SelectMove(game, 1);
+    ASSERT_TRUE(move.has_value());
+    ++counts[*move];
+  }
+  // Joining the two dots closes nothing, so the cell between them weighs
+  // the same as the cells touching both of them diagonally.
+  EXPECT_LT(counts[3 * 8 + 3], 2 * counts[2 * 8 + 3]);
+}
+
+TEST(RolloutTest, DoesNotAllocateWhenWarm) {
+  Game game(16, 16);
+  game.PlaceDot(8 * 16 + 8, 1);
+  Rollout rollout({}, 5);
+  // The first playouts grow the buffers to the most polygons a playout
+  // keeps at once, the rest should only reuse them.
+  size_t allocated = 0;
+  size_t moves = 0;
+  uint32_t captured = 0;
+  for (int i = 0; i < 48; ++i) {
+    size_t checkpoint = game.Checkpoint();
+    size_t before = allocations;
+    Rollout::Result result = rollout.Play(game, 2);
+    if (i >= 32) {
+      allocated += allocations - before;
+      moves += result.moves;
+      captured += result.scores[0] + result.scores[1];
+    }
+    game.Rollback(checkpoint);
+  }
+  ASSERT_GT(moves, 0);
+  // Captures go through the polygon updates.
+  EXPECT_GT(captured, 0);
+  EXPECT_EQ(allocated, 0) << "in " << moves << " moves";
+}
+
+TEST(RolloutTest, NoMoves) {
+  Game game(4, 4);
+  Rollout rollout({}, 4);
+  EXPECT_EQ(rollout.SelectMove(game, 1), std::nullopt);
+  EXPECT_EQ(rollout.Play(game, 1).moves, 0);
+}
+
+}  // namespace
+}  // namespace uchen::demo
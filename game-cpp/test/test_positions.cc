@@ -0,0 +1,18 @@
+#include "test/test_positions.h"
+
+#include "src/game.h"
+
+namespace uchen::demo {
+
+Game CapturePosition() {
+  Game game(8, 8);
+  game.PlaceDot(2 * 8 + 3, 1);
+  game.PlaceDot(3 * 8 + 3, 2);
+  game.PlaceDot(3 * 8 + 2, 1);
+  game.PlaceDot(0, 2);
+  game.PlaceDot(3 * 8 + 4, 1);
+  game.PlaceDot(7, 2);
+  return game;
+}
+
+}  // namespace uchen::demo
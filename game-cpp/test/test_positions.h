@@ -0,0 +1,14 @@
+#ifndef TEST_TEST_POSITIONS_H
+#define TEST_TEST_POSITIONS_H
+
+#include "src/game.h"
+
+namespace uchen::demo {
+
+// Player 1 to move captures the dot at (3, 3) by playing (3, 4) on an 8x8
+// board.
+Game CapturePosition();
+
+}  // namespace uchen::demo
+
+#endif  // TEST_TEST_POSITIONS_H
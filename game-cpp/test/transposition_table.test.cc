@@ -0,0 +1,42 @@
+#include "src/transposition_table.h"
+
+#include <cstdint>
+#include <optional>
+
+#include <gtest/gtest.h>
+
+using uchen::demo::TranspositionTable;
+
+TEST(TranspositionTableTest, StoreAndProbe) {
+  TranspositionTable table(4);
+  EXPECT_EQ(table.size(), 16);
+  EXPECT_FALSE(table.Probe(0x1234).has_value());
+  table.Store(0x1234, {.move = 2079,
+                       .depth = 3,
+                       .bound = TranspositionTable::Bound::kLower,
+                       .value = -1.5f});
+  std::optional<TranspositionTable::Entry> entry = table.Probe(0x1234);
+  ASSERT_TRUE(entry.has_value());
+  EXPECT_EQ(entry->move, 2079);
+  EXPECT_EQ(entry->depth, 3);
+  EXPECT_EQ(entry->bound, TranspositionTable::Bound::kLower);
+  EXPECT_EQ(entry->value, -1.5f);
+  // Same slot, different key.
+  EXPECT_FALSE(table.Probe(0x1244).has_value());
+  table.Clear();
+  EXPECT_FALSE(table.Probe(0x1234).has_value());
+}
+
+TEST(TranspositionTableTest, Replacement) {
+  TranspositionTable table(4);
+  table.Store(0x10, {.move = 1, .depth = 2, .value = 1.f});
+  // Shallower result for the same position is ignored.
+  table.Store(0x10, {.move = 2, .depth = 1, .value = 2.f});
+  EXPECT_EQ(table.Probe(0x10)->move, 1);
+  table.Store(0x10, {.move = 3, .depth = 2, .value = 3.f});
+  EXPECT_EQ(table.Probe(0x10)->move, 3);
+  // Other positions always replace.
+  table.Store(0x20, {.move = 4, .depth = 0, .value = 4.f});
+  EXPECT_FALSE(table.Probe(0x10).has_value());
+  EXPECT_EQ(table.Probe(0x20)->move, 4);
+}
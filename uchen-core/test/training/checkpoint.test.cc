@@ -0,0 +1,105 @@
+#include "uchen/training/checkpoint.h"
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "uchen/layers.h"
+#include "uchen/linear.h"
+#include "uchen/parameters.h"
+#include "uchen/training/optimizer.h"
+#include "uchen/training/parameter_gradients.h"
+#include "uchen/vector.h"
+
+namespace uchen::training::testing {
+
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+
+auto model = layers::Input<Vector<float, 2>> | layers::Linear<3> |
+             layers::Relu | layers::Linear<1>;
+using M = decltype(model);
+
+std::string TempFile(const std::string& name) {
+  return ::testing::TempDir() + "/" + name;
+}
+
+TEST(CheckpointTest, RoundTrip) {
+  std::vector<float> values(M::all_parameters_count());
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = i * 0.5f;
+  }
+  std::string path = TempFile("round_trip.ckpt");
+  {
+    std::ofstream out(path, std::ios::binary);
+    ASSERT_TRUE(WriteCheckpoint(out, ModelParameters(&model, values), 7));
+  }
+  std::optional checkpoint = LoadCheckpoint(&model, path);
+  ASSERT_TRUE(checkpoint.has_value());
+  EXPECT_EQ(checkpoint->generation, 7);
+  EXPECT_TRUE(checkpoint->moments.empty());
+  EXPECT_THAT(checkpoint->parameters, ElementsAreArray(values));
+  // Parameters are not copied out of the mapped file.
+  auto [layer, handle] =
+      checkpoint->parameters.parameters()->GetLayerParameters(0);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(layer.data()) % 64, 0);
+}
+
+TEST(CheckpointTest, OptimizerState) {
+  ModelParameters<M> parameters(&model, 1.f);
+  ParameterGradients<M> gradients;
+  for (size_t i = 0; i < gradients.size(); ++i) {
+    gradients[i] = i;
+  }
+  Adam<M> adam;
+  auto [updated, next] = adam(parameters, gradients, 1, 0.1f);
+  std::string path = TempFile("optimizer.ckpt");
+  {
+    std::ofstream out(path, std::ios::binary);
+    ASSERT_TRUE(WriteCheckpoint(out, updated, 1, &adam.state()));
+  }
+  std::optional checkpoint = LoadCheckpoint(&model, path);
+  ASSERT_TRUE(checkpoint.has_value());
+  EXPECT_EQ(checkpoint->optimizer_step, 2);
+  ASSERT_EQ(checkpoint->moments.size(), 2);
+  EXPECT_THAT(checkpoint->parameters, ElementsAreArray(updated));
+  Adam<M> restored;
+  checkpoint->RestoreOptimizer(restored.state());
+  EXPECT_EQ(restored.state().step(), 2);
+  for (size_t i = 0; i < 2; ++i) {
+    EXPECT_THAT(restored.state().moment(i),
+                ElementsAreArray(adam.state().moment(i)));
+  }
+  // Both continue the same way.
+  EXPECT_THAT(restored(checkpoint->parameters, gradients, 1, 0.1f).first,
+              ElementsAreArray(next(updated, gradients, 1, 0.1f).first));
+}
+
+TEST(CheckpointTest, RejectsOtherModels) {
+  auto other = layers::Input<Vector<float, 2>> | layers::Linear<4> |
+               layers::Relu | layers::Linear<1>;
+  std::string path = TempFile("other.ckpt");
+  {
+    std::ofstream out(path, std::ios::binary);
+    ASSERT_TRUE(WriteCheckpoint(out, ModelParameters(&other, 1.f), 0));
+  }
+  EXPECT_FALSE(LoadCheckpoint(&model, path).has_value());
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "definitely not a checkpoint, but long enough to have a header "
+           "if it was one";
+  }
+  EXPECT_FALSE(LoadCheckpoint(&model, path).has_value());
+  EXPECT_FALSE(LoadCheckpoint(&model, TempFile("missing.ckpt")).has_value());
+}
+
+}  // namespace
+
+}  // namespace uchen::training::testing
@@ -0,0 +1,160 @@
+#include "uchen/training/optimizer.h"
+
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "uchen/layers.h"
+#include "uchen/parameters.h"
+#include "uchen/training/training.h"
+#include "uchen/vector.h"
+
+namespace uchen::training::testing {
+
+namespace {
+
+using ::testing::Each;
+using ::testing::ElementsAre;
+using ::testing::FloatNear;
+using ::testing::Pointwise;
+
+// Long enough for full vectors and a scalar tail on any target.
+constexpr size_t kSize = 133;
+
+std::vector<float> Sequence(float start, float step) {
+  std::vector<float> result(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    result[i] = start + step * i;
+  }
+  return result;
+}
+
+TEST(OptimizerTest, AdamUpdateMatchesReference) {
+  std::vector parameters = Sequence(-1, 0.02f);
+  std::vector gradients = Sequence(3, -0.05f);
+  std::vector m = Sequence(0.1f, 0.001f);
+  std::vector v = Sequence(0.2f, 0.003f);
+  AdamStep step = {.learning_rate = 0.01f,
+                   .beta1 = 0.9f,
+                   .beta2 = 0.999f,
+                   .epsilon = 1e-8f,
+                   .weight_decay = 0.1f,
+                   .bias_correction1 = 1 - std::pow(0.9f, 3.f),
+                   .bias_correction2 = 1 - std::pow(0.999f, 3.f),
+                   .gradient_scale = 0.5f};
+  std::vector<float> expected_p(kSize), expected_m(kSize), expected_v(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    float g = gradients[i] * 0.5f;
+    expected_m[i] = 0.9f * m[i] + 0.1f * g;
+    expected_v[i] = 0.999f * v[i] + 0.001f * g * g;
+    float m_hat = expected_m[i] / step.bias_correction1;
+    float v_hat = expected_v[i] / step.bias_correction2;
+    expected_p[i] = parameters[i] - 0.01f * 0.1f * parameters[i] -
+                    0.01f * m_hat / (std::sqrt(v_hat) + 1e-8f);
+  }
+  AdamUpdate(parameters, gradients, m, v, step);
+  EXPECT_THAT(m, Pointwise(FloatNear(1e-6), expected_m));
+  EXPECT_THAT(v, Pointwise(FloatNear(1e-6), expected_v));
+  EXPECT_THAT(parameters, Pointwise(FloatNear(1e-5), expected_p));
+}
+
+TEST(OptimizerTest, MomentumUpdateMatchesReference) {
+  std::vector parameters = Sequence(-1, 0.02f);
+  std::vector gradients = Sequence(3, -0.05f);
+  std::vector velocity = Sequence(0.1f, 0.001f);
+  std::vector<float> expected_p(kSize), expected_velocity(kSize);
+  for (size_t i = 0; i < kSize; ++i) {
+    expected_velocity[i] = 0.9f * velocity[i] + gradients[i] * 0.25f;
+    expected_p[i] = parameters[i] - 0.1f * expected_velocity[i];
+  }
+  MomentumUpdate(parameters, gradients, velocity,
+                 {.learning_rate = 0.1f,
+                  .momentum = 0.9f,
+                  .weight_decay = 0,
+                  .gradient_scale = 0.25f});
+  EXPECT_THAT(velocity, Pointwise(FloatNear(1e-6), expected_velocity));
+  EXPECT_THAT(parameters, Pointwise(FloatNear(1e-6), expected_p));
+}
+
+TEST(OptimizerTest, ChunkRunnerCoversTheSpanOnEveryRun) {
+  // Enough floats for several threads on a multi-core host.
+  constexpr size_t kRunnerSize = (1 << 19) + 5;
+  ChunkRunner runner(kRunnerSize);
+  std::vector<int> visits(kRunnerSize, 0);
+  for (int run = 0; run < 3; ++run) {
+    runner.Run([&](size_t begin, size_t size) {
+      for (size_t i = begin; i < begin + size; ++i) {
+        ++visits[i];
+      }
+    });
+  }
+  EXPECT_THAT(visits, Each(3));
+}
+
+TEST(OptimizerTest, AdamFirstStep) {
+  auto model = layers::Input<Vector<float, 1>> | layers::Linear<1>;
+  ModelParameters<decltype(model)> parameters(&model, {1.f, 2});
+  ParameterGradients<decltype(model)> gradients;
+  gradients[0] = 4;
+  gradients[1] = -2;
+  auto [updated, next] =
+      Adam<decltype(model)>()(parameters, gradients, 2, 0.1f);
+  // Bias corrected moments of the first step are the gradient, every
+  // parameter moves by the learning rate.
+  EXPECT_THAT(updated, ElementsAre(FloatNear(0.9f, 1e-5),
+                                   FloatNear(2.1f, 1e-5)));
+  // Input parameters are left alone.
+  EXPECT_THAT(parameters, ElementsAre(1, 2));
+  // Next step updates the same store in place.
+  auto [again, last] = next(updated, gradients, 2, 0.1f);
+  EXPECT_EQ(again.parameters(), updated.parameters());
+}
+
+TEST(OptimizerTest, TrainsLinearModel) {
+  auto model = layers::Input<Vector<float, 1>> | layers::Linear<1>;
+  TrainingData<Vector<float, 1>, Vector<float, 1>> data = {
+      {{-2}, {-3}},
+      {{0}, {1}},
+      {{2}, {5}},
+  };
+  Training training(&model, ModelParameters(&model, {0.f, -1}),
+                    DefaultLoss<Vector<float, 1>>::type(),
+                    SgdMomentum<decltype(model)>());
+  for (size_t generation = 1; training.Loss(data) > 0.0001; ++generation) {
+    training = training.Generation(data, 0.05);
+    ASSERT_LT(generation, 500);
+  }
+  EXPECT_THAT(training.parameters(),
+              ElementsAre(FloatNear(1, 0.02), FloatNear(2, 0.02)));
+}
+
+TEST(OptimizerTest, EpochStepsInChunks) {
+  auto model = layers::Input<Vector<float, 1>> | layers::Linear<4>;
+  static_assert(ChunkedOptimizer<Adam<decltype(model)>, decltype(model)>);
+  std::vector<std::pair<Vector<float, 1>, Vector<float, 4>>> samples;
+  for (int i = -20; i < 20; ++i) {
+    float x = i / 10.f;
+    samples.push_back({{x}, {x, 2 * x, -x, 1}});
+  }
+  TrainingData<Vector<float, 1>, Vector<float, 4>> data(samples.begin(),
+                                                        samples.end());
+  ModelParameters parameters(&model, {0.f, 1, 2, 3, 4, 5, 6, 7});
+  // A single batch is the same step as a generation.
+  Training epoch(&model, parameters, DefaultLoss<Vector<float, 4>>::type(),
+                 Adam<decltype(model)>());
+  epoch = epoch.Epoch(data, samples.size(), 0.1f);
+  Training generation(&model, parameters,
+                      DefaultLoss<Vector<float, 4>>::type(),
+                      Adam<decltype(model)>());
+  generation = generation.Generation(data, 0.1f);
+  EXPECT_THAT(epoch.parameters(),
+              Pointwise(FloatNear(1e-5), generation.parameters()));
+  EXPECT_EQ(epoch.optimizer().state().step(), 2);
+}
+
+}  // namespace
+
+}  // namespace uchen::training::testing
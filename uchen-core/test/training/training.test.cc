@@ -49,6 +49,56 @@ TEST(TrainingTest, Grad) {
   EXPECT_NEAR(training.Loss(arr), 3.48, 0.001);
 }
 
+TEST(TrainingTest, SampleLosses) {
+  auto model = layers::Input<Vector<float, 1>> | layers::Linear<1>;
+  TrainingData<Vector<float, 1>, Vector<float, 1>> arr = {
+      {{0}, {1}},
+      {{1}, {3}},
+      {{2}, {6}},
+  };
+  Training training(&model, ModelParameters(&model, {-2.f, 2}));
+  std::vector<float> losses(arr.size());
+  training = training.Generation(arr, 0.1, nullptr, losses);
+  // Losses of the parameters before the update.
+  EXPECT_THAT(losses, ::testing::ElementsAre(9, 9, 16));
+}
+
+TEST(TrainingTest, EpochWithOneBatchIsGeneration) {
+  auto model = layers::Input<Vector<float, 1>> | layers::Linear<1>;
+  TrainingData<Vector<float, 1>, Vector<float, 1>> arr = {
+      {{0}, {1}},
+      {{1}, {3}},
+      {{2}, {5}},
+  };
+  Training training(&model, ModelParameters(&model, {-2.f, 2}));
+  double loss = 0;
+  training = training.Epoch(arr, 3, 0.1, &loss);
+  EXPECT_EQ(loss, 9);
+  EXPECT_THAT(training.parameters(), ::testing::ElementsAre(-1.4, 2.6));
+}
+
+TEST(TrainingTest, EpochMiniBatches) {
+  auto model = layers::Input<Vector<float, 1>> | layers::Linear<1>;
+  std::vector<std::pair<Vector<float, 1>, Vector<float, 1>>> samples;
+  for (int i = -20; i < 20; ++i) {
+    float x = i / 10.f;
+    samples.push_back({{x}, {2 * x + 1}});
+  }
+  TrainingData<Vector<float, 1>, Vector<float, 1>> data(samples.begin(),
+                                                        samples.end());
+  Training training(&model, ModelParameters(&model, {0.f, 0}));
+  double first = 0;
+  training = training.Epoch(data, 8, 0.1, &first);
+  double loss = first;
+  for (size_t epoch = 1; epoch < 20; ++epoch) {
+    training = training.Epoch(data, 8, 0.1, &loss);
+  }
+  EXPECT_LT(loss, first / 100);
+  EXPECT_THAT(training.parameters(),
+              ::testing::ElementsAre(::testing::FloatNear(1, 0.05),
+                                     ::testing::FloatNear(2, 0.05)));
+}
+
 class MoveOnly {
  public:
   MoveOnly() = default;
@@ -393,7 +393,14 @@ ModelParameters<M> RandomParameters(const M* m, float min, float max,
 template <typename Model>
 std::shared_ptr<internal::FlatStore<Model>> ParametersCopy(
     const ModelParameters<Model>& parameters) {
-  return NewFlatStore(parameters.model(), parameters.begin(), parameters.end());
+  auto store = NewFlatStore(parameters.model());
+  // Layer by layer, the iterators look up the layer of every element.
+  auto out = store->data().begin();
+  for (size_t layer = 0; layer < Model::kLayers; ++layer) {
+    auto [span, handle] = parameters.parameters()->GetLayerParameters(layer);
+    out = std::copy(span.begin(), span.end(), out);
+  }
+  return store;
 }
 
 }  // namespace uchen
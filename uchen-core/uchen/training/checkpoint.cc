@@ -0,0 +1,176 @@
+#include "uchen/training/checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "absl/log/log.h"
+
+namespace uchen::training {
+namespace {
+
+constexpr std::array<char, 8> kMagic = {'u', 'c', 'h', 'e', 'n', 'c', 'k', 'p'};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kAlignment = 64;
+
+constexpr size_t Aligned(size_t size) {
+  return (size + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+bool WritePadding(std::ostream& out, size_t size) {
+  static constexpr std::array<char, kAlignment> kZeros = {};
+  out.write(kZeros.data(), Aligned(size) - size);
+  return static_cast<bool>(out);
+}
+
+}  // namespace
+
+// static
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Can not open " << path << ": " << std::strerror(errno);
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    LOG(ERROR) << "Can not map empty or unreadable file " << path;
+    close(fd);
+    return nullptr;
+  }
+  // Shared so processes mapping the same checkpoint share the pages.
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // Mapping stays valid after the descriptor is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Can not map " << path << ": " << std::strerror(errno);
+    return nullptr;
+  }
+  return std::shared_ptr<MappedFile>(new MappedFile(std::span<const char>(
+      static_cast<const char*>(data), static_cast<size_t>(st.st_size))));
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<char*>(data_.data()), data_.size());
+}
+
+namespace internal {
+
+bool WriteCheckpoint(std::ostream& out, uint64_t generation,
+                     std::span<const uint64_t> layer_sizes,
+                     std::span<const std::span<const float>> layers,
+                     size_t optimizer_step,
+                     std::span<const std::span<const float>> moments) {
+  uint64_t parameters = 0;
+  for (std::span<const float> layer : layers) {
+    parameters += layer.size();
+  }
+  CheckpointHeader header = {
+      .magic = kMagic,
+      .version = kVersion,
+      .layers = static_cast<uint32_t>(layer_sizes.size()),
+      .generation = generation,
+      .optimizer_step = optimizer_step,
+      .moments = moments.size(),
+      .parameters = parameters,
+      .data_offset =
+          sizeof(CheckpointHeader) + Aligned(layer_sizes.size_bytes()),
+      .reserved = 0};
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(layer_sizes.data()),
+            layer_sizes.size_bytes());
+  if (!WritePadding(out, layer_sizes.size_bytes())) {
+    return false;
+  }
+  for (std::span<const float> layer : layers) {
+    out.write(reinterpret_cast<const char*>(layer.data()), layer.size_bytes());
+  }
+  if (!WritePadding(out, parameters * sizeof(float))) {
+    return false;
+  }
+  for (std::span<const float> moment : moments) {
+    if (moment.size() != parameters) {
+      LOG(ERROR) << "Moment has " << moment.size() << " values, expected "
+                 << parameters;
+      return false;
+    }
+    out.write(reinterpret_cast<const char*>(moment.data()),
+              moment.size_bytes());
+    if (!WritePadding(out, moment.size_bytes())) {
+      return false;
+    }
+  }
+  return static_cast<bool>(out);
+}
+
+std::optional<CheckpointView> ParseCheckpoint(
+    std::span<const char> file, std::span<const uint64_t> layer_sizes) {
+  CheckpointView view;
+  if (file.size() < sizeof(CheckpointHeader)) {
+    LOG(ERROR) << "Checkpoint is too short";
+    return std::nullopt;
+  }
+  std::memcpy(&view.header, file.data(), sizeof(CheckpointHeader));
+  const CheckpointHeader& header = view.header;
+  if (header.magic != kMagic) {
+    LOG(ERROR) << "Not a checkpoint";
+    return std::nullopt;
+  }
+  if (header.version != kVersion) {
+    LOG(ERROR) << "Unsupported checkpoint version " << header.version;
+    return std::nullopt;
+  }
+  // Model signature, the parameter count of every layer.
+  const size_t signature_end =
+      sizeof(CheckpointHeader) + header.layers * sizeof(uint64_t);
+  if (header.layers != layer_sizes.size() || file.size() < signature_end ||
+      !std::equal(layer_sizes.begin(), layer_sizes.end(),
+                  reinterpret_cast<const uint64_t*>(file.data() +
+                                                    sizeof(CheckpointHeader)))) {
+    LOG(ERROR) << "Checkpoint is for a different model";
+    return std::nullopt;
+  }
+  uint64_t parameters = 0;
+  for (uint64_t size : layer_sizes) {
+    parameters += size;
+  }
+  if (header.parameters != parameters) {
+    LOG(ERROR) << "Checkpoint has " << header.parameters
+               << " parameters, the model has " << parameters;
+    return std::nullopt;
+  }
+  const size_t section = Aligned(header.parameters * sizeof(float));
+  if (header.data_offset % kAlignment != 0 ||
+      header.data_offset < signature_end ||
+      file.size() < header.data_offset + section * (header.moments + 1)) {
+    LOG(ERROR) << "Checkpoint is truncated";
+    return std::nullopt;
+  }
+  // Mapping starts on a page, the sections are aligned for floats.
+  auto floats = [&](size_t offset) {
+    return std::span(reinterpret_cast<const float*>(file.data() + offset),
+                     header.parameters);
+  };
+  view.parameters = floats(header.data_offset);
+  for (size_t i = 1; i <= header.moments; ++i) {
+    view.moments.push_back(floats(header.data_offset + section * i));
+  }
+  return view;
+}
+
+}  // namespace internal
+}  // namespace uchen::training
@@ -0,0 +1,181 @@
+#ifndef UCHEN_TRAINING_CHECKPOINT_H
+#define UCHEN_TRAINING_CHECKPOINT_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "uchen/memory.h"
+#include "uchen/parameters.h"
+#include "uchen/training/optimizer.h"
+
+namespace uchen::training {
+
+// Checkpoint file layout, every section starts at a multiple of 64 bytes:
+//   header (64 bytes)
+//   parameter count of every layer, uint64
+//   parameters, float
+//   optimizer moments, float, as many as the header says, each as long as
+//   the parameters
+// Numbers are in the byte order of the machine that wrote the file.
+struct CheckpointHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t layers;
+  uint64_t generation;
+  uint64_t optimizer_step;
+  uint64_t moments;
+  uint64_t parameters;
+  // Offset of the parameters from the start of the file.
+  uint64_t data_offset;
+  uint64_t reserved;
+};
+
+static_assert(sizeof(CheckpointHeader) == 64);
+
+// Read-only memory mapping of a whole file.
+class MappedFile final : public memory::Deletable {
+ public:
+  // nullptr if the file can not be opened or mapped.
+  static std::shared_ptr<MappedFile> Open(const std::string& path);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() override;
+
+  std::span<const char> data() const { return data_; }
+
+ private:
+  explicit MappedFile(std::span<const char> data) : data_(data) {}
+
+  std::span<const char> data_;
+};
+
+namespace internal {
+
+struct CheckpointView {
+  CheckpointHeader header;
+  std::span<const float> parameters;
+  std::vector<std::span<const float>> moments;
+};
+
+bool WriteCheckpoint(std::ostream& out, uint64_t generation,
+                     std::span<const uint64_t> layer_sizes,
+                     std::span<const std::span<const float>> layers,
+                     size_t optimizer_step,
+                     std::span<const std::span<const float>> moments);
+
+// Checks the header and the layer sizes, the spans point into the file.
+std::optional<CheckpointView> ParseCheckpoint(
+    std::span<const char> file, std::span<const uint64_t> layer_sizes);
+
+template <typename Model>
+std::vector<uint64_t> LayerSizes() {
+  std::vector<uint64_t> sizes;
+  for (size_t layer = 0; layer < Model::kLayers; ++layer) {
+    auto [start, end] = uchen::internal::LayerIndexes<Model>::start_end(layer);
+    sizes.push_back(end - start);
+  }
+  return sizes;
+}
+
+// Parameters that stay in the mapped file.
+template <typename Model>
+class MappedStore final
+    : public Store,
+      public std::enable_shared_from_this<MappedStore<Model>> {
+ public:
+  MappedStore(std::shared_ptr<const MappedFile> file,
+              std::span<const float> data)
+      : file_(std::move(file)), data_(data) {}
+
+  std::pair<std::span<const float>, std::shared_ptr<memory::Deletable>>
+  GetLayerParameters(size_t layer) override {
+    auto [start, end] = uchen::internal::LayerIndexes<Model>::start_end(layer);
+    return {data_.subspan(start, end - start), this->shared_from_this()};
+  }
+
+ private:
+  std::shared_ptr<const MappedFile> file_;
+  std::span<const float> data_;
+};
+
+}  // namespace internal
+
+template <typename Model>
+struct Checkpoint {
+  ModelParameters<Model> parameters;
+  uint64_t generation;
+  size_t optimizer_step;
+  // Point into the mapped file, which is kept as long as the parameters are.
+  std::vector<std::span<const float>> moments;
+
+  // Continues training with the optimizer state of the checkpoint. Does
+  // nothing for checkpoints written without one.
+  void RestoreOptimizer(OptimizerState<Model>& state) const {
+    if (!moments.empty()) {
+      state.Restore(optimizer_step, moments);
+    }
+  }
+};
+
+// Optimizer state is optional.
+template <typename Model>
+bool WriteCheckpoint(std::ostream& out,
+                     const ModelParameters<Model>& parameters,
+                     uint64_t generation,
+                     const OptimizerState<Model>* optimizer = nullptr) {
+  std::vector<std::span<const float>> layers;
+  // Keeps the layers alive while they are written.
+  std::vector<std::shared_ptr<memory::Deletable>> handles;
+  for (size_t layer = 0; layer < Model::kLayers; ++layer) {
+    auto [span, handle] = parameters.parameters()->GetLayerParameters(layer);
+    layers.push_back(span);
+    handles.push_back(std::move(handle));
+  }
+  std::vector<std::span<const float>> moments;
+  size_t step = 0;
+  if (optimizer != nullptr) {
+    step = optimizer->step();
+    for (size_t i = 0; i < optimizer->moments(); ++i) {
+      moments.push_back(optimizer->moment(i));
+    }
+  }
+  return internal::WriteCheckpoint(out, generation,
+                                   internal::LayerSizes<Model>(), layers, step,
+                                   moments);
+}
+
+// Maps the file, the parameters are read from it as they are used instead of
+// being copied. nullopt if the file is not a checkpoint of this model.
+template <typename Model>
+std::optional<Checkpoint<Model>> LoadCheckpoint(const Model* model,
+                                                const std::string& path) {
+  std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+  if (file == nullptr) {
+    return std::nullopt;
+  }
+  std::optional<internal::CheckpointView> view =
+      internal::ParseCheckpoint(file->data(), internal::LayerSizes<Model>());
+  if (!view.has_value()) {
+    return std::nullopt;
+  }
+  return Checkpoint<Model>{
+      .parameters = ModelParameters<Model>(
+          model, std::make_shared<internal::MappedStore<Model>>(
+                     std::move(file), view->parameters)),
+      .generation = view->header.generation,
+      .optimizer_step = view->header.optimizer_step,
+      .moments = std::move(view->moments)};
+}
+
+}  // namespace uchen::training
+
+#endif  // UCHEN_TRAINING_CHECKPOINT_H
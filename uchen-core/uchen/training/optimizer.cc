@@ -0,0 +1,179 @@
+#include "uchen/training/optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <thread>
+
+#include "absl/functional/function_ref.h"
+#include "absl/log/check.h"  // IWYU pragma: keep
+
+#include "hwy/highway.h"
+
+namespace uchen::training {
+
+namespace hn = ::hwy::HWY_NAMESPACE;
+HWY_BEFORE_NAMESPACE();
+
+namespace HWY_NAMESPACE {
+
+namespace {
+
+HWY_ATTR void AdamChunk(float* HWY_RESTRICT parameters,
+                        const float* HWY_RESTRICT gradients,
+                        float* HWY_RESTRICT m, float* HWY_RESTRICT v,
+                        size_t size, const AdamStep& step) {
+  using D = hn::ScalableTag<float>;
+  const D d;
+  const size_t lanes = hn::Lanes(d);
+  const float step_size = step.learning_rate / step.bias_correction1;
+  const float inv_sqrt_bc2 = 1 / std::sqrt(step.bias_correction2);
+  const float decay = 1 - step.learning_rate * step.weight_decay;
+  const auto beta1 = hn::Set(d, step.beta1);
+  const auto beta2 = hn::Set(d, step.beta2);
+  const auto one_minus_beta1 = hn::Set(d, 1 - step.beta1);
+  const auto one_minus_beta2 = hn::Set(d, 1 - step.beta2);
+  const auto scale = hn::Set(d, step.gradient_scale);
+  const auto epsilon = hn::Set(d, step.epsilon);
+  const auto sqrt_scale = hn::Set(d, inv_sqrt_bc2);
+  const auto neg_step = hn::Set(d, -step_size);
+  const auto decay_v = hn::Set(d, decay);
+  size_t i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    auto g = hn::Mul(hn::LoadU(d, gradients + i), scale);
+    // m = beta1 * m + (1 - beta1) * g
+    auto mv =
+        hn::MulAdd(beta1, hn::LoadU(d, m + i), hn::Mul(one_minus_beta1, g));
+    // v = beta2 * v + (1 - beta2) * g^2
+    auto vv = hn::MulAdd(beta2, hn::LoadU(d, v + i),
+                         hn::Mul(one_minus_beta2, hn::Mul(g, g)));
+    auto denominator = hn::MulAdd(hn::Sqrt(vv), sqrt_scale, epsilon);
+    auto p = hn::Mul(hn::LoadU(d, parameters + i), decay_v);
+    p = hn::MulAdd(neg_step, hn::Div(mv, denominator), p);
+    hn::StoreU(mv, d, m + i);
+    hn::StoreU(vv, d, v + i);
+    hn::StoreU(p, d, parameters + i);
+  }
+  for (; i < size; ++i) {
+    float g = gradients[i] * step.gradient_scale;
+    m[i] = step.beta1 * m[i] + (1 - step.beta1) * g;
+    v[i] = step.beta2 * v[i] + (1 - step.beta2) * g * g;
+    parameters[i] = parameters[i] * decay -
+                    step_size * m[i] /
+                        (std::sqrt(v[i]) * inv_sqrt_bc2 + step.epsilon);
+  }
+}
+
+HWY_ATTR void MomentumChunk(float* HWY_RESTRICT parameters,
+                            const float* HWY_RESTRICT gradients,
+                            float* HWY_RESTRICT velocity, size_t size,
+                            const MomentumStep& step) {
+  using D = hn::ScalableTag<float>;
+  const D d;
+  const size_t lanes = hn::Lanes(d);
+  const float decay = 1 - step.learning_rate * step.weight_decay;
+  const auto momentum = hn::Set(d, step.momentum);
+  const auto scale = hn::Set(d, step.gradient_scale);
+  const auto neg_rate = hn::Set(d, -step.learning_rate);
+  const auto decay_v = hn::Set(d, decay);
+  size_t i = 0;
+  for (; i + lanes <= size; i += lanes) {
+    // velocity = momentum * velocity + g
+    auto u = hn::MulAdd(momentum, hn::LoadU(d, velocity + i),
+                        hn::Mul(hn::LoadU(d, gradients + i), scale));
+    auto p = hn::Mul(hn::LoadU(d, parameters + i), decay_v);
+    hn::StoreU(u, d, velocity + i);
+    hn::StoreU(hn::MulAdd(neg_rate, u, p), d, parameters + i);
+  }
+  for (; i < size; ++i) {
+    velocity[i] = step.momentum * velocity[i] +
+                  gradients[i] * step.gradient_scale;
+    parameters[i] = parameters[i] * decay - step.learning_rate * velocity[i];
+  }
+}
+
+}  // namespace
+
+// NOLINTNEXTLINE(google-readability-namespace-comments)
+}  // namespace HWY_NAMESPACE
+HWY_AFTER_NAMESPACE();
+
+namespace {
+
+// Below this many floats per thread waking the thread costs more than the
+// update.
+constexpr size_t kMinChunk = 1 << 16;
+
+}  // namespace
+
+ChunkRunner::ChunkRunner(size_t size)
+    : size_(size),
+      threads_(std::clamp<size_t>(
+          size / kMinChunk, 1,
+          std::max(1u, std::thread::hardware_concurrency()))),
+      // Chunks start on a cache line.
+      chunk_(((size + threads_ - 1) / threads_ + 15) & ~size_t{15}),
+      start_(static_cast<std::ptrdiff_t>(threads_)),
+      done_(static_cast<std::ptrdiff_t>(threads_)) {
+  for (size_t thread = 1; thread < threads_; ++thread) {
+    workers_.emplace_back([this, thread]() {
+      while (true) {
+        start_.arrive_and_wait();
+        if (fn_ == nullptr) {
+          return;
+        }
+        RunChunk(thread);
+        done_.arrive_and_wait();
+      }
+    });
+  }
+}
+
+ChunkRunner::~ChunkRunner() {
+  if (threads_ > 1) {
+    fn_ = nullptr;
+    start_.arrive_and_wait();
+  }
+}
+
+void ChunkRunner::Run(absl::FunctionRef<void(size_t, size_t)> fn) {
+  if (threads_ == 1) {
+    fn(0, size_);
+    return;
+  }
+  fn_ = &fn;
+  start_.arrive_and_wait();
+  RunChunk(0);
+  done_.arrive_and_wait();
+  fn_ = nullptr;
+}
+
+void ChunkRunner::RunChunk(size_t thread) {
+  size_t begin = thread * chunk_;
+  if (begin < size_) {
+    (*fn_)(begin, std::min(chunk_, size_ - begin));
+  }
+}
+
+void AdamUpdate(std::span<float> parameters, std::span<const float> gradients,
+                std::span<float> m, std::span<float> v, const AdamStep& step) {
+  CHECK_EQ(parameters.size(), gradients.size());
+  CHECK_EQ(parameters.size(), m.size());
+  CHECK_EQ(parameters.size(), v.size());
+  HWY_STATIC_DISPATCH(AdamChunk)
+  (parameters.data(), gradients.data(), m.data(), v.data(), parameters.size(),
+   step);
+}
+
+void MomentumUpdate(std::span<float> parameters,
+                    std::span<const float> gradients,
+                    std::span<float> velocity, const MomentumStep& step) {
+  CHECK_EQ(parameters.size(), gradients.size());
+  CHECK_EQ(parameters.size(), velocity.size());
+  HWY_STATIC_DISPATCH(MomentumChunk)
+  (parameters.data(), gradients.data(), velocity.data(), parameters.size(),
+   step);
+}
+
+}  // namespace uchen::training
@@ -0,0 +1,255 @@
+#ifndef UCHEN_TRAINING_OPTIMIZER_H
+#define UCHEN_TRAINING_OPTIMIZER_H
+
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/log/check.h"
+
+#include "uchen/parameters.h"
+#include "uchen/training/parameter_gradients.h"
+
+namespace uchen::training {
+
+struct AdamStep {
+  float learning_rate;
+  float beta1;
+  float beta2;
+  float epsilon;
+  // Decoupled from the gradient, as in AdamW. 0 is plain Adam.
+  float weight_decay;
+  // 1 - beta ^ step.
+  float bias_correction1;
+  float bias_correction2;
+  // Applied to the gradients before anything else, 1 / batch size.
+  float gradient_scale;
+};
+
+struct MomentumStep {
+  float learning_rate;
+  float momentum;
+  float weight_decay;
+  float gradient_scale;
+};
+
+// Fused update kernels, parameters and moments are updated in place in one
+// pass on the calling thread. Use ChunkRunner to split large spans.
+void AdamUpdate(std::span<float> parameters, std::span<const float> gradients,
+                std::span<float> m, std::span<float> v, const AdamStep& step);
+void MomentumUpdate(std::span<float> parameters,
+                    std::span<const float> gradients,
+                    std::span<float> velocity, const MomentumStep& step);
+
+// Calls fn(begin, size) on consecutive chunks of [0, size), one chunk per
+// thread. The threads start with the runner and wait between the runs, so an
+// optimizer step does not start any. Run() should not be called from several
+// threads at once.
+class ChunkRunner {
+ public:
+  explicit ChunkRunner(size_t size);
+  ~ChunkRunner();
+
+  ChunkRunner(const ChunkRunner&) = delete;
+  ChunkRunner& operator=(const ChunkRunner&) = delete;
+
+  void Run(absl::FunctionRef<void(size_t begin, size_t size)> fn);
+
+ private:
+  void RunChunk(size_t thread);
+
+  size_t size_;
+  size_t threads_;
+  size_t chunk_;
+  const absl::FunctionRef<void(size_t, size_t)>* fn_ = nullptr;
+  std::barrier<> start_;
+  std::barrier<> done_;
+  // Last, so the threads are joined before the barriers go away.
+  std::vector<std::jthread> workers_;
+};
+
+// Parameters the optimizer updates in place, with the moment buffers that
+// persist between steps. The first step copies the parameters it is given,
+// later steps that get the parameters of the previous step reuse them.
+template <typename M>
+class OptimizerState {
+ public:
+  explicit OptimizerState(size_t moments)
+      : moments_(moments,
+                 std::vector<float>(M::all_parameters_count(), 0.f)),
+        runner_(M::all_parameters_count()) {}
+
+  std::span<float> Parameters(const ModelParameters<M>& parameters) {
+    if (store_ == nullptr || parameters.parameters() != store_) {
+      store_ = ParametersCopy(parameters);
+    }
+    return store_->data();
+  }
+  // Parameters of the last Parameters() call.
+  std::span<float> parameters() { return store_->data(); }
+
+  ModelParameters<M> Updated(const M* model) const {
+    return ModelParameters<M>(model, store_);
+  }
+
+  size_t moments() const { return moments_.size(); }
+  std::span<float> moment(size_t i) { return moments_[i]; }
+  std::span<const float> moment(size_t i) const { return moments_[i]; }
+  // Runs fn(begin, size) on chunks of the parameters in parallel.
+  void ForEachChunk(absl::FunctionRef<void(size_t begin, size_t size)> fn) {
+    runner_.Run(fn);
+  }
+  // Steps taken so far plus one.
+  size_t step() const { return step_; }
+  void NextStep() { ++step_; }
+
+  // Continues from a checkpoint of an optimizer of the same kind.
+  void Restore(size_t step, std::span<const std::span<const float>> moments) {
+    CHECK_EQ(moments.size(), moments_.size());
+    for (size_t i = 0; i < moments.size(); ++i) {
+      CHECK_EQ(moments[i].size(), moments_[i].size());
+      std::copy(moments[i].begin(), moments[i].end(), moments_[i].begin());
+    }
+    step_ = step;
+  }
+
+ private:
+  std::shared_ptr<uchen::internal::FlatStore<M>> store_;
+  std::vector<std::vector<float>> moments_;
+  ChunkRunner runner_;
+  size_t step_ = 1;
+};
+
+// Optimizers for Training. Copies share the state, so the Training of the
+// next generation continues with the same moments and update threads.
+// Returned parameters are updated in place by the next step, copy them with
+// ParametersCopy() to keep a snapshot.
+
+template <typename M>
+class Adam {
+ public:
+  struct Options {
+    float beta1 = 0.9f;
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+    // Non-zero makes it AdamW.
+    float weight_decay = 0;
+  };
+
+  Adam() : Adam(Options{}) {}
+  explicit Adam(Options options)
+      : options_(options),
+        state_(std::make_shared<OptimizerState<M>>(2)) {}
+
+  std::pair<ModelParameters<M>, Adam> operator()(
+      const ModelParameters<M>& params, const ParameterGradients<M>& grads,
+      size_t batch_size, float learning_rate) const {
+    Begin(params);
+    std::span<const float> gradients = grads.data();
+    state_->ForEachChunk([&](size_t begin, size_t size) {
+      Update(gradients.subspan(begin, size), begin, batch_size, learning_rate);
+    });
+    return End(params.model());
+  }
+
+  // operator() split up for callers that run their own threads. Begin() takes
+  // the parameters, then Update() is called for chunks of the gradients that
+  // together cover all of them, possibly from several threads at once, and
+  // End() finishes the step.
+  void Begin(const ModelParameters<M>& params) const {
+    state_->Parameters(params);
+  }
+
+  void Update(std::span<const float> gradients, size_t begin,
+              size_t batch_size, float learning_rate) const {
+    CHECK_GT(batch_size, 0);
+    float step = static_cast<float>(state_->step());
+    size_t size = gradients.size();
+    AdamUpdate(state_->parameters().subspan(begin, size), gradients,
+               state_->moment(0).subspan(begin, size),
+               state_->moment(1).subspan(begin, size),
+               {.learning_rate = learning_rate,
+                .beta1 = options_.beta1,
+                .beta2 = options_.beta2,
+                .epsilon = options_.epsilon,
+                .weight_decay = options_.weight_decay,
+                .bias_correction1 = 1 - std::pow(options_.beta1, step),
+                .bias_correction2 = 1 - std::pow(options_.beta2, step),
+                .gradient_scale = 1.f / batch_size});
+  }
+
+  std::pair<ModelParameters<M>, Adam> End(const M* model) const {
+    state_->NextStep();
+    return {state_->Updated(model), *this};
+  }
+
+  OptimizerState<M>& state() const { return *state_; }
+
+ private:
+  Options options_;
+  std::shared_ptr<OptimizerState<M>> state_;
+};
+
+template <typename M>
+class SgdMomentum {
+ public:
+  struct Options {
+    float momentum = 0.9f;
+    float weight_decay = 0;
+  };
+
+  SgdMomentum() : SgdMomentum(Options{}) {}
+  explicit SgdMomentum(Options options)
+      : options_(options),
+        state_(std::make_shared<OptimizerState<M>>(1)) {}
+
+  std::pair<ModelParameters<M>, SgdMomentum> operator()(
+      const ModelParameters<M>& params, const ParameterGradients<M>& grads,
+      size_t batch_size, float learning_rate) const {
+    Begin(params);
+    std::span<const float> gradients = grads.data();
+    state_->ForEachChunk([&](size_t begin, size_t size) {
+      Update(gradients.subspan(begin, size), begin, batch_size, learning_rate);
+    });
+    return End(params.model());
+  }
+
+  // Same as Adam::Begin(), Update() and End().
+  void Begin(const ModelParameters<M>& params) const {
+    state_->Parameters(params);
+  }
+
+  void Update(std::span<const float> gradients, size_t begin,
+              size_t batch_size, float learning_rate) const {
+    CHECK_GT(batch_size, 0);
+    size_t size = gradients.size();
+    MomentumUpdate(state_->parameters().subspan(begin, size), gradients,
+                   state_->moment(0).subspan(begin, size),
+                   {.learning_rate = learning_rate,
+                    .momentum = options_.momentum,
+                    .weight_decay = options_.weight_decay,
+                    .gradient_scale = 1.f / batch_size});
+  }
+
+  std::pair<ModelParameters<M>, SgdMomentum> End(const M* model) const {
+    state_->NextStep();
+    return {state_->Updated(model), *this};
+  }
+
+  OptimizerState<M>& state() const { return *state_; }
+
+ private:
+  Options options_;
+  std::shared_ptr<OptimizerState<M>> state_;
+};
+
+}  // namespace uchen::training
+
+#endif  // UCHEN_TRAINING_OPTIMIZER_H
@@ -1,6 +1,7 @@
 #ifndef UCHEN_TRAINING_PARAMETER_GRADIENTS_H
 #define UCHEN_TRAINING_PARAMETER_GRADIENTS_H
 
+#include <algorithm>
 #include <cstddef>
 #include <span>
 #include <vector>
@@ -33,6 +34,11 @@ class ParameterGradients {
 
   static constexpr size_t size() { return Model::all_parameters_count(); }
 
+  std::span<float> data() { return gradients_; }
+  std::span<const float> data() const { return gradients_; }
+
+  void Clear() { std::fill(gradients_.begin(), gradients_.end(), 0.f); }
+
   auto begin() const { return gradients_.begin(); }
   auto end() const { return gradients_.end(); }
 
@@ -4,11 +4,13 @@
 #include <algorithm>
 #include <array>
 #include <barrier>
+#include <concepts>
 #include <cstddef>
 #include <initializer_list>
 #include <iterator>
 #include <memory>
 #include <ostream>
+#include <random>
 #include <span>
 #include <thread>
 #include <utility>
@@ -67,14 +69,16 @@ class Projection final : public Store<V> {
 template <typename V>
 class ShuffledStore final : public Store<V> {
  public:
-  explicit ShuffledStore(std::shared_ptr<Store<V>> store)
+  explicit ShuffledStore(std::shared_ptr<Store<V>> store,
+                         std::default_random_engine::result_type seed =
+                             std::default_random_engine::default_seed)
       : store_(std::move(store)) {
     indexes_.reserve(store_->size());
     for (size_t i = 0; i < store_->size(); ++i) {
       indexes_.emplace_back(i);
     }
     std::shuffle(indexes_.begin(), indexes_.end(),
-                 std::default_random_engine());
+                 std::default_random_engine(seed));
   }
 
   size_t size() const override { return indexes_.size(); }
@@ -165,8 +169,10 @@ class TrainingData {
             std::make_shared<Projection<value_type>>(store_, arr1, size())));
   }
 
-  TrainingData Shuffle() const {
-    return TrainingData(std::make_shared<ShuffledStore<value_type>>(store_));
+  TrainingData Shuffle(std::default_random_engine::result_type seed =
+                           std::default_random_engine::default_seed) const {
+    return TrainingData(
+        std::make_shared<ShuffledStore<value_type>>(store_, seed));
   }
 
   std::vector<TrainingData> BatchWithSize(size_t batch_size) const {
@@ -219,16 +225,27 @@ struct SgdOptimizer {
   }
 };
 
+// Optimizers that can take a step in chunks from several threads, see
+// Adam::Begin(). Training::Epoch() splits their steps between its workers.
+template <typename O, typename M>
+concept ChunkedOptimizer =
+    requires(const O& optimizer, const ModelParameters<M>& parameters,
+             std::span<const float> gradients) {
+      optimizer.Begin(parameters);
+      optimizer.Update(gradients, size_t{0}, size_t{1}, 1.f);
+      {
+        optimizer.End(parameters.model())
+      } -> std::same_as<std::pair<ModelParameters<M>, O>>;
+    };
+
 template <typename M, typename Optimizer = SgdOptimizer<M>,
           typename L = typename DefaultLoss<typename M::output_t>::type>
 class Training {
  public:
   Training(const M* model, const ModelParameters<M>& parameters,
            L loss_fn = L(), Optimizer optimizer = Optimizer())
-      : model_(model),
-        parameters_(parameters),
-        loss_fn_(loss_fn),
-        optimizer_(std::move(optimizer)) {}
+      : Training(model, parameters, std::move(loss_fn), std::move(optimizer),
+                 0) {}
 
   template <typename I>
   double Loss(const TrainingData<I, typename L::value_type>& data_set) const {
@@ -253,9 +270,13 @@ class Training {
     return loss / data_set.size();
   }
 
+  // Loss of every sample is written to sample_losses unless it is empty, in
+  // the order of the data set.
   template <typename I>
   Training Generation(const TrainingData<I, typename L::value_type>& data_set,
-                      float learning_rate, double* out_loss = nullptr) const {
+                      float learning_rate, double* out_loss = nullptr,
+                      std::span<float> sample_losses = {}) const {
+    DCHECK(sample_losses.empty() || sample_losses.size() == data_set.size());
     if (data_set.empty()) {
       if (out_loss != nullptr) {
         *out_loss = 0;
@@ -270,8 +291,14 @@ class Training {
     std::vector<std::pair<ParameterGradients<M>, float>> gradients_losses(
         batches.size());
     std::barrier sync{static_cast<unsigned int>(batches.size() + 1), []() {}};
+    size_t offset = 0;
     for (size_t i = 0; i < batches.size(); ++i) {
-      workers.emplace_back(model_, batches[i], parameters_, loss_fn_);
+      std::span<float> losses =
+          sample_losses.empty()
+              ? sample_losses
+              : sample_losses.subspan(offset, batches[i].size());
+      workers.emplace_back(model_, batches[i], parameters_, loss_fn_, losses);
+      offset += batches[i].size();
     }
     for (auto& worker : workers) {
       runners.emplace_back([&]() { worker(); });
@@ -294,24 +321,131 @@ class Training {
     }
     auto [updated, next_gen] =
         optimizer_(parameters_, grads, data_set.size(), learning_rate);
-    return Training(model_, updated, loss_fn_, next_gen);
+    return Training(model_, updated, loss_fn_, next_gen, epoch_);
+  }
+
+  // One pass over the shuffled data set with an optimizer step after every
+  // batch_size samples. Threads and their gradient buffers live for the whole
+  // epoch, each step splits its batch between them. With a ChunkedOptimizer
+  // every thread then sums the gradients and updates the parameters for its
+  // own slice, other optimizers take the whole step on the last thread to
+  // finish the batch. Every epoch of a training shuffles the data
+  // differently. out_loss gets the mean loss of the samples before the step
+  // of their batch.
+  template <typename I>
+  Training Epoch(const TrainingData<I, typename L::value_type>& data_set,
+                 size_t batch_size, float learning_rate,
+                 double* out_loss = nullptr) const {
+    CHECK_GT(batch_size, 0);
+    if (out_loss != nullptr) {
+      *out_loss = 0;
+    }
+    if (data_set.empty()) {
+      return Training(model_, parameters_, loss_fn_, optimizer_, epoch_ + 1);
+    }
+    constexpr bool kChunked = ChunkedOptimizer<Optimizer, M>;
+    const std::vector batches =
+        data_set.Shuffle(epoch_ + 1).BatchWithSize(batch_size);
+    const size_t threads = tasks(std::min(batch_size, data_set.size()));
+    std::vector<ParameterGradients<M>> gradients(threads);
+    std::vector<double> losses(threads, 0);
+    ModelParameters<M> parameters = parameters_;
+    Optimizer optimizer = optimizer_;
+    size_t batch = 0;
+    auto next = [&](std::pair<ModelParameters<M>, Optimizer> step) {
+      parameters = std::move(step.first);
+      optimizer = std::move(step.second);
+      ++batch;
+    };
+    // Runs once all the threads have the gradients of the batch.
+    auto gathered = [&]() noexcept {
+      if constexpr (kChunked) {
+        optimizer.Begin(parameters);
+      } else {
+        for (size_t i = 1; i < threads; ++i) {
+          gradients.front() += gradients[i];
+        }
+        next(optimizer(parameters, gradients.front(), batches[batch].size(),
+                       learning_rate));
+      }
+    };
+    // Runs once all the threads have updated their slices.
+    auto updated = [&]() noexcept {
+      if constexpr (kChunked) {
+        next(optimizer.End(model_));
+      }
+    };
+    std::barrier gather_sync(static_cast<std::ptrdiff_t>(threads), gathered);
+    std::barrier update_sync(static_cast<std::ptrdiff_t>(threads), updated);
+    auto worker = [&](size_t thread) {
+      // Slices start on a cache line.
+      constexpr size_t kCount = M::all_parameters_count();
+      const size_t slice_begin = (kCount * thread / threads) & ~size_t{15};
+      const size_t slice_end = thread + 1 == threads
+                                   ? kCount
+                                   : (kCount * (thread + 1) / threads) &
+                                         ~size_t{15};
+      while (batch < batches.size()) {
+        const auto& samples = batches[batch];
+        ParameterGradients<M>& sum = gradients[thread];
+        sum.Clear();
+        for (size_t i = samples.size() * thread / threads;
+             i < samples.size() * (thread + 1) / threads; ++i) {
+          losses[thread] +=
+              AddGradients(samples[i].first, samples[i].second, parameters,
+                           sum);
+        }
+        gather_sync.arrive_and_wait();
+        if constexpr (kChunked) {
+          std::span<float> slice = gradients.front().data().subspan(
+              slice_begin, slice_end - slice_begin);
+          for (size_t i = 1; i < threads; ++i) {
+            std::span<const float> other = gradients[i].data().subspan(
+                slice_begin, slice_end - slice_begin);
+            for (size_t j = 0; j < slice.size(); ++j) {
+              slice[j] += other[j];
+            }
+          }
+          optimizer.Update(slice, slice_begin, samples.size(), learning_rate);
+          update_sync.arrive_and_wait();
+        }
+      }
+    };
+    std::vector<std::jthread> runners;
+    for (size_t thread = 1; thread < threads; ++thread) {
+      runners.emplace_back(worker, thread);
+    }
+    worker(0);
+    // Joins the threads!
+    runners.clear();
+    if (out_loss != nullptr) {
+      for (double loss : losses) {
+        *out_loss += loss;
+      }
+      *out_loss /= data_set.size();
+    }
+    return Training(model_, parameters, loss_fn_, optimizer, epoch_ + 1);
   }
 
   ModelParameters<M> parameters() const { return parameters_; }
 
+  const Optimizer& optimizer() const { return optimizer_; }
+
  private:
   class GradientWorker {
    public:
     explicit GradientWorker(
         const M* model,
         TrainingData<typename M::input_t, typename L::value_type> batch,
-        ModelParameters<M> parameters, L loss_fn_)
+        ModelParameters<M> parameters, L loss_fn_, std::span<float> losses)
         : model_(model),
           batch_(std::move(batch)),
           loss_fn_(std::move(loss_fn_)),
-          parameters_(parameters) {}
+          parameters_(parameters),
+          losses_(losses) {}
 
     void operator()() {
+      size_t sample = 0;
       for (const auto& [input, y_hat] : batch_) {
         ForwardPassResult fpr(model_, input, parameters_);
         auto per_run_gradients = fpr.CalculateParameterGradients(
@@ -320,6 +454,10 @@ class Training {
         float per_run_loss = loss_fn_.Loss(fpr.result(), y_hat);
         gradients_ += per_run_gradients;
         loss_ += per_run_loss;
+        if (!losses_.empty()) {
+          losses_[sample] = per_run_loss;
+        }
+        ++sample;
       }
     }
 
@@ -334,8 +472,29 @@ class Training {
     float loss_;
     L loss_fn_;
     ModelParameters<M> parameters_;
+    std::span<float> losses_;
   };
 
+  Training(const M* model, const ModelParameters<M>& parameters, L loss_fn,
+           Optimizer optimizer, size_t epoch)
+      : model_(model),
+        parameters_(parameters),
+        loss_fn_(std::move(loss_fn)),
+        optimizer_(std::move(optimizer)),
+        epoch_(epoch) {}
+
+  // Adds the gradients of one sample, returns its loss.
+  float AddGradients(const typename M::input_t& input,
+                     const typename L::value_type& y_hat,
+                     const ModelParameters<M>& parameters,
+                     ParameterGradients<M>& gradients) const {
+    ForwardPassResult fpr(model_, input, parameters);
+    gradients +=
+        fpr.CalculateParameterGradients(loss_fn_.Gradient(fpr.result(), y_hat))
+            .second;
+    return loss_fn_.Loss(fpr.result(), y_hat);
+  }
+
   uint32_t tasks(size_t data_samples) const {
     return std::max(std::min(std::thread::hardware_concurrency(),
                              static_cast<unsigned int>(data_samples / 5)),
@@ -346,6 +505,8 @@ class Training {
   ModelParameters<M> parameters_;
   L loss_fn_;
   Optimizer optimizer_;
+  // Epochs run so far, seeds the shuffle of the next one.
+  size_t epoch_;
 };
 
 }  // namespace uchen::training